@@ -0,0 +1,244 @@
+#ifndef ACCOUNT_STORE_H
+#define ACCOUNT_STORE_H
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <sys/mman.h>
+
+// Size of one cache line on the x86-64 machines we benchmark on (Sunlab)
+constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+// How the accounts are laid out in memory
+enum class StoreLayout
+{
+    Map,    // the original std::map<int, T> (one tree node per account)
+    Packed, // contiguous array, accounts back to back (best for balance() scans)
+    Padded  // contiguous array, one account per cache line (no false sharing between deposits)
+};
+
+template <typename T>
+struct PackedCell
+{
+    T value;
+};
+
+template <typename T>
+struct alignas(CACHE_LINE_SIZE) PaddedCell
+{
+    T value;
+};
+
+// A memory mapping an AccountStore serves its accounts from (a checkpoint, see checkpoint.h):
+// the cells start at data(), and the whole mapping is unmapped with the store
+class AccountMapping
+{
+public:
+    AccountMapping() = default;
+    AccountMapping(void *base, std::size_t length, void *data) : base(base), length(length), cells(data) {}
+    AccountMapping(AccountMapping &&other) noexcept { *this = std::move(other); }
+    AccountMapping &operator=(AccountMapping &&other) noexcept
+    {
+        std::swap(base, other.base);
+        std::swap(length, other.length);
+        std::swap(cells, other.cells);
+        return *this;
+    }
+    AccountMapping(const AccountMapping &) = delete;
+    AccountMapping &operator=(const AccountMapping &) = delete;
+
+    ~AccountMapping()
+    {
+        if (base != nullptr)
+        {
+            munmap(base, length);
+        }
+    }
+
+    void *data() const { return cells; }
+    explicit operator bool() const { return base != nullptr; }
+
+private:
+    void *base = nullptr;
+    std::size_t length = 0;
+    void *cells = nullptr;
+};
+
+// Dense account storage indexed by account slot. Account IDs are 1..N like in main(),
+// so account ID i lives in slot i - 1 and a lookup is a single array index.
+// Iterating yields {first = ID, second = balance} entries so code written against
+// std::map<int, T> (e.g. "for (const auto &account : bankAccounts)") works unchanged.
+template <typename T, template <typename> class Cell>
+class AccountStore
+{
+public:
+    using mapped_type = T; // same name as std::map so BalanceOf<> works on both
+
+    template <typename Ref>
+    struct Entry
+    {
+        int first;
+        Ref second;
+    };
+
+    template <typename CellPtr, typename Ref>
+    class Iterator
+    {
+    public:
+        Iterator(CellPtr cell, int accountID) : cell(cell), accountID(accountID) {}
+        Entry<Ref> operator*() const { return {accountID, cell->value}; }
+        Iterator &operator++()
+        {
+            ++cell;
+            ++accountID;
+            return *this;
+        }
+        bool operator!=(const Iterator &other) const { return cell != other.cell; }
+
+    private:
+        CellPtr cell;
+        int accountID;
+    };
+
+    using iterator = Iterator<Cell<T> *, T &>;
+    using const_iterator = Iterator<const Cell<T> *, const T &>;
+
+    explicit AccountStore(int numAccounts) : owned(numAccounts), cells(owned.data()), numCells(numAccounts) {}
+
+    // Serves the numAccounts cells the mapping holds (laid out like this store's) in place:
+    // nothing is allocated or initialized, every page is read in on its first access
+    AccountStore(int numAccounts, AccountMapping mapping)
+        : mapped(std::move(mapping)), cells(static_cast<Cell<T> *>(mapped.data())), numCells(numAccounts) {}
+
+    T &operator[](int accountID) { return cells[accountID - 1].value; }
+    const T &operator[](int accountID) const { return cells[accountID - 1].value; }
+
+    int size() const { return static_cast<int>(numCells); }
+
+    iterator begin() { return iterator(cells, 1); }
+    iterator end() { return iterator(cells + numCells, size() + 1); }
+    const_iterator begin() const { return const_iterator(cells, 1); }
+    const_iterator end() const { return const_iterator(cells + numCells, size() + 1); }
+
+private:
+    std::vector<Cell<T>> owned; // never resized, so references stay valid while threads run
+    AccountMapping mapped;      // or the cells live in a mapping
+    Cell<T> *cells;
+    std::size_t numCells;
+};
+
+template <typename T>
+using PackedAccountStore = AccountStore<T, PackedCell>;
+
+template <typename T>
+using PaddedAccountStore = AccountStore<T, PaddedCell>;
+
+// Calls fn(accountID, balance) for the accounts first..last (inclusive) in ID order, until fn
+// returns false; returns whether it went through the whole range
+template <typename T, template <typename> class Cell, typename Fn>
+bool forEachAccount(const AccountStore<T, Cell> &bankAccounts, int first, int last, Fn &&fn)
+{
+    for (int account = first; account <= last; ++account)
+    {
+        if (!fn(account, bankAccounts[account]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename T, typename Fn>
+bool forEachAccount(const std::map<int, T> &bankAccounts, int first, int last, Fn &&fn)
+{
+    for (auto account = bankAccounts.lower_bound(first); account != bankAccounts.end() && account->first <= last; ++account)
+    {
+        if (!fn(account->first, account->second))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// True for the dense stores, whose slots can be written from several threads at once
+template <typename Accounts>
+struct IsAccountStore : std::false_type
+{
+};
+
+template <typename T, template <typename> class Cell>
+struct IsAccountStore<AccountStore<T, Cell>> : std::true_type
+{
+};
+
+inline bool parseStoreLayout(const std::string &name, StoreLayout &layout)
+{
+    if (name == "map")
+        layout = StoreLayout::Map;
+    else if (name == "packed")
+        layout = StoreLayout::Packed;
+    else if (name == "padded")
+        layout = StoreLayout::Padded;
+    else
+        return false;
+    return true;
+}
+
+inline const char *storeLayoutName(StoreLayout layout)
+{
+    switch (layout)
+    {
+    case StoreLayout::Map:
+        return "map";
+    case StoreLayout::Packed:
+        return "packed";
+    case StoreLayout::Padded:
+        return "padded";
+    }
+    return "unknown";
+}
+
+// Builds the chosen account store and hands it to fn, so an engine written as a
+// template over the account container runs unchanged on every layout. A packed store is
+// served from mapping if there is one; the other layouts ignore it.
+template <typename T, typename Fn>
+int withAccountStore(StoreLayout layout, int numAccounts, AccountMapping mapping, Fn &&fn)
+{
+    switch (layout)
+    {
+    case StoreLayout::Map:
+    {
+        std::map<int, T> bankAccounts;
+        return fn(bankAccounts);
+    }
+    case StoreLayout::Packed:
+    {
+        if (mapping)
+        {
+            PackedAccountStore<T> bankAccounts(numAccounts, std::move(mapping));
+            return fn(bankAccounts);
+        }
+        PackedAccountStore<T> bankAccounts(numAccounts);
+        return fn(bankAccounts);
+    }
+    case StoreLayout::Padded:
+    {
+        PaddedAccountStore<T> bankAccounts(numAccounts);
+        return fn(bankAccounts);
+    }
+    }
+    return 1;
+}
+
+template <typename T, typename Fn>
+int withAccountStore(StoreLayout layout, int numAccounts, Fn &&fn)
+{
+    return withAccountStore<T>(layout, numAccounts, AccountMapping(), std::forward<Fn>(fn));
+}
+
+#endif
@@ -0,0 +1,173 @@
+#ifndef AUDIT_POOL_H
+#define AUDIT_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "balance_sum.h"
+#include "balance_types.h"
+
+// Accounts summed by one task of a parallel audit
+constexpr std::size_t AUDIT_CHUNK_ACCOUNTS = std::size_t(1) << 16;
+
+// Helper threads for the audits (--audit-threads=N): one balance() scan is split into chunks
+// that the helpers and the auditing worker take from a shared cursor, and run() returns only
+// after every chunk is done. Whatever the engine holds during the scan (a lock, a closed
+// gate) or checks after it (sequence numbers) therefore covers the helpers' reads too. The
+// pool runs one scan at a time: a worker that audits while it is busy scans alone instead of
+// waiting for it.
+class AuditPool
+{
+public:
+    explicit AuditPool(int numHelpers)
+    {
+        for (int i = 0; i < numHelpers; ++i)
+        {
+            helpers.emplace_back([this] { serve(); });
+        }
+    }
+
+    ~AuditPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &helper : helpers)
+        {
+            helper.join();
+        }
+    }
+
+    AuditPool(const AuditPool &) = delete;
+    AuditPool &operator=(const AuditPool &) = delete;
+
+    int size() const { return static_cast<int>(helpers.size()); }
+
+    // Calls task(chunk) once for every chunk in 0..numChunks-1 and returns when all calls have
+    // returned (which happens-before the return)
+    template <typename Task>
+    void run(std::size_t numChunks, Task &task)
+    {
+        if (helpers.empty() || numChunks < 2 || !scanMutex.try_lock())
+        {
+            for (std::size_t chunk = 0; chunk < numChunks; ++chunk)
+            {
+                task(chunk);
+            }
+            return;
+        }
+
+        Job current{&task, [](void *context, std::size_t chunk)
+                    { (*static_cast<Task *>(context))(chunk); },
+                    numChunks};
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = current;
+            nextChunk.store(0, std::memory_order_relaxed);
+            ++generation;
+        }
+        wake.notify_all();
+        work(current);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        job.context = nullptr; // no helper joins this scan any more
+        idle.wait(lock, [this] { return busyHelpers == 0; });
+        lock.unlock();
+        scanMutex.unlock();
+    }
+
+private:
+    struct Job
+    {
+        void *context = nullptr; // the task, nullptr while no scan is running
+        void (*invoke)(void *context, std::size_t chunk) = nullptr;
+        std::size_t numChunks = 0;
+    };
+
+    void serve()
+    {
+        std::uint64_t served = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            wake.wait(lock, [&] { return stopping || (job.context != nullptr && generation != served); });
+            if (stopping)
+            {
+                return;
+            }
+            served = generation;
+            Job current = job;
+            ++busyHelpers;
+            lock.unlock();
+            work(current);
+            lock.lock();
+            if (--busyHelpers == 0)
+            {
+                idle.notify_one();
+            }
+        }
+    }
+
+    void work(const Job &current)
+    {
+        for (std::size_t chunk = nextChunk.fetch_add(1, std::memory_order_relaxed); chunk < current.numChunks;
+             chunk = nextChunk.fetch_add(1, std::memory_order_relaxed))
+        {
+            current.invoke(current.context, chunk);
+        }
+    }
+
+    std::vector<std::thread> helpers;
+    std::mutex scanMutex;                // held by the worker whose scan runs on the pool
+    std::mutex mutex;                    // guards everything below but nextChunk
+    std::condition_variable wake;        // a scan started (or the pool stops)
+    std::condition_variable idle;        // the last helper left the scan
+    Job job;                             // the running scan
+    std::uint64_t generation = 0;        // scans started, so a helper joins each one at most once
+    int busyHelpers = 0;                 // helpers working on the running scan
+    bool stopping = false;
+    std::atomic<std::size_t> nextChunk{0}; // next chunk to hand out
+};
+
+// Sum of every balance in bankAccounts (IDs 1..size()), in chunks of AUDIT_CHUNK_ACCOUNTS over
+// the pool; with no helpers, or fewer than two chunks, the plain sumBalances()
+template <typename Accounts>
+BalanceOf<Accounts> parallelSumBalances(AuditPool &pool, const Accounts &bankAccounts)
+{
+    using Balance = BalanceOf<Accounts>;
+    const std::size_t numAccounts = bankAccounts.size();
+    const std::size_t numChunks = (numAccounts + AUDIT_CHUNK_ACCOUNTS - 1) / AUDIT_CHUNK_ACCOUNTS;
+    if (pool.size() == 0 || numChunks < 2)
+    {
+        return sumBalances(bankAccounts);
+    }
+
+    thread_local std::vector<BalanceSum<Balance>> chunkSums; // running totals: float chunks are not rounded on their own
+    std::vector<BalanceSum<Balance>> &partials = chunkSums; // the auditor's own, the helpers must not name the thread_local
+    partials.assign(numChunks, BalanceSum<Balance>());
+    auto task = [&](std::size_t chunk)
+    {
+        std::size_t first = chunk * AUDIT_CHUNK_ACCOUNTS + 1;
+        std::size_t last = std::min(first + AUDIT_CHUNK_ACCOUNTS - 1, numAccounts);
+        partials[chunk] = partialSumBalances(bankAccounts, static_cast<int>(first), static_cast<int>(last));
+        std::atomic_thread_fence(std::memory_order_acquire); // for the engines that validate the scan afterwards (as if the auditor read these balances)
+    };
+    pool.run(numChunks, task);
+
+    BalanceSum<Balance> total;
+    for (const auto &partial : partials)
+    {
+        total.add(partial);
+    }
+    return total.total();
+}
+
+#endif
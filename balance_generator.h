@@ -0,0 +1,220 @@
+#ifndef BALANCE_GENERATOR_H
+#define BALANCE_GENERATOR_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "account_store.h"
+#include "balance_types.h"
+
+// Shape of the initial balances
+enum class BalanceDistribution
+{
+    Preset,    // the hand-written arrays for 3, 10, 20 and 60 accounts (uniform for any other count)
+    Uniform,   // balances uniform in [0, 2 * mean]
+    Lognormal, // lognormal with sigma = shape (default 1.0)
+    Pareto     // Pareto with alpha = shape (default 1.16, the "80/20" tail)
+};
+
+struct BalanceSpec
+{
+    BalanceDistribution distribution = BalanceDistribution::Preset;
+    double total = 100000.0; // dollars; the generated balances always sum to exactly this many cents
+    double shape = 0.0;      // 0 = the distribution's default
+    std::uint64_t seed = 375;
+};
+
+// Accounts per generation chunk. Every chunk has its own RNG stream seeded from its index,
+// so the balances only depend on the seed, never on how many threads generated them.
+constexpr int BALANCE_CHUNK_SIZE = 1 << 16;
+
+inline std::vector<float> getInitialBalances(int num_accounts)
+{
+    if (num_accounts == 3)
+    {
+        return {40000.0f, 30000.0f, 30000.0f};
+    }
+    else if (num_accounts == 10)
+    {
+        return {10000.0f, 8000.0f, 12000.0f, 9000.0f, 15000.0f,
+                7000.0f, 13000.0f, 6000.0f, 11000.0f, 9000.0f}; // 10 values array
+    }
+    else if (num_accounts == 20)
+    {
+        return {5000.0f, 1000.0f, 4000.0f, 6000.0f, 5000.0f,
+                4000.0f, 6000.0f, 4000.0f, 5000.0f, 2000.0f,
+                4000.0f, 9000.0f, 5000.0f, 4000.0f, 5000.0f,
+                5000.0f, 4000.0f, 6000.0f, 7000.0f, 9000.0f}; // 20 values array
+    }
+    else if (num_accounts == 60)
+    {
+        return {12400.0f, 2000.0f, 1500.0f, 1200.0f, 1800.0f, 2200.0f, 1700.0f, 1000.0f,
+                1500.0f, 1200.0f, 1800.0f, 2200.0f, 1700.0f, 1000.0f, 1500.0f, 1200.0f,
+                1800.0f, 2200.0f, 1700.0f, 1000.0f, 1500.0f, 1200.0f, 1800.0f, 2200.0f,
+                1700.0f, 1000.0f, 1500.0f, 1200.0f, 1800.0f, 2200.0f, 1700.0f, 1000.0f,
+                1500.0f, 1200.0f, 1800.0f, 2200.0f, 1700.0f, 1000.0f, 2500.0f, 1200.0f,
+                1800.0f, 2200.0f, 1700.0f, 1000.0f, 1500.0f, 1200.0f, 1800.0f, 2200.0f,
+                1700.0f, 1000.0f, 1500.0f, 1200.0f, 1800.0f, 2200.0f, 1700.0f, 1000.0f}; // 60 values array
+    }
+    return {};
+}
+
+inline bool parseBalanceDistribution(const std::string &name, BalanceDistribution &distribution)
+{
+    if (name == "preset")
+        distribution = BalanceDistribution::Preset;
+    else if (name == "uniform")
+        distribution = BalanceDistribution::Uniform;
+    else if (name == "lognormal")
+        distribution = BalanceDistribution::Lognormal;
+    else if (name == "pareto")
+        distribution = BalanceDistribution::Pareto;
+    else
+        return false;
+    return true;
+}
+
+inline const char *balanceDistributionName(BalanceDistribution distribution)
+{
+    switch (distribution)
+    {
+    case BalanceDistribution::Preset:
+        return "preset";
+    case BalanceDistribution::Uniform:
+        return "uniform";
+    case BalanceDistribution::Lognormal:
+        return "lognormal";
+    case BalanceDistribution::Pareto:
+        return "pareto";
+    }
+    return "unknown";
+}
+
+// Generates unnormalized weights for the accounts of one chunk (slots [begin, end))
+class BalanceWeights
+{
+public:
+    BalanceWeights(const BalanceSpec &spec, int numAccounts)
+        : spec(spec), preset(spec.distribution == BalanceDistribution::Preset ? getInitialBalances(numAccounts) : std::vector<float>()) {}
+
+    template <typename Fn>
+    void forChunk(int chunk, int begin, int end, Fn &&fn) const
+    {
+        std::mt19937_64 gen(spec.seed * 0x9E3779B97F4A7C15ull + static_cast<std::uint64_t>(chunk));
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        std::lognormal_distribution<double> lognormal(0.0, spec.shape > 0 ? spec.shape : 1.0);
+        double alpha = spec.shape > 0 ? spec.shape : 1.16;
+
+        for (int slot = begin; slot < end; ++slot)
+        {
+            double weight;
+            if (!preset.empty())
+                weight = preset[slot];
+            else if (spec.distribution == BalanceDistribution::Lognormal)
+                weight = lognormal(gen);
+            else if (spec.distribution == BalanceDistribution::Pareto)
+                weight = std::pow(1.0 - uniform(gen), -1.0 / alpha); // inverse CDF, minimum 1
+            else
+                weight = uniform(gen); // Uniform, or Preset without a preset for this count
+            fn(slot, weight);
+        }
+    }
+
+private:
+    BalanceSpec spec;
+    std::vector<float> preset;
+};
+
+// Runs fn(chunk, begin, end) for every chunk of [0, numAccounts) on numThreads threads
+template <typename Fn>
+void forEachBalanceChunk(int numAccounts, int numThreads, Fn &&fn)
+{
+    int numChunks = (numAccounts + BALANCE_CHUNK_SIZE - 1) / BALANCE_CHUNK_SIZE;
+    numThreads = std::max(1, std::min(numThreads, numChunks));
+
+    auto worker = [&](int t)
+    {
+        for (int chunk = t; chunk < numChunks; chunk += numThreads)
+        {
+            int begin = chunk * BALANCE_CHUNK_SIZE;
+            fn(chunk, begin, std::min(numAccounts, begin + BALANCE_CHUNK_SIZE));
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int t = 1; t < numThreads; ++t)
+    {
+        threads.emplace_back(worker, t);
+    }
+    worker(0);
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+}
+
+// Calls set(accountID, cents) once for every account 1..numAccounts. The balances follow
+// spec.distribution and sum to exactly spec.total dollars: each account gets the floor of its
+// share and the leftover cents go one each to the first accounts. With numThreads > 1, set()
+// is called concurrently for different accounts.
+template <typename SetFn>
+void generateBalances(const BalanceSpec &spec, int numAccounts, int numThreads, SetFn &&set)
+{
+    const BalanceWeights weights(spec, numAccounts);
+    const Cents totalCents = toBalance<Cents>(spec.total);
+    int numChunks = (numAccounts + BALANCE_CHUNK_SIZE - 1) / BALANCE_CHUNK_SIZE;
+
+    // pass 1: total weight (per chunk, then summed in chunk order so the result is deterministic)
+    std::vector<double> chunkWeights(numChunks, 0.0);
+    forEachBalanceChunk(numAccounts, numThreads, [&](int chunk, int begin, int end)
+                        { weights.forChunk(chunk, begin, end, [&](int, double weight)
+                                           { chunkWeights[chunk] += weight; }); });
+    double totalWeight = 0.0;
+    for (double chunkWeight : chunkWeights)
+    {
+        totalWeight += chunkWeight;
+    }
+    const double centsPerWeight = totalWeight > 0 ? static_cast<double>(totalCents) / totalWeight : 0.0;
+
+    // pass 2: how many cents flooring every share leaves over
+    std::vector<Cents> chunkCents(numChunks, 0);
+    forEachBalanceChunk(numAccounts, numThreads, [&](int chunk, int begin, int end)
+                        { weights.forChunk(chunk, begin, end, [&](int, double weight)
+                                           { chunkCents[chunk] += static_cast<Cents>(std::floor(weight * centsPerWeight)); }); });
+    Cents leftover = totalCents; // in [0, numAccounts) unless rounding pushed the floors over the total
+    for (Cents cents : chunkCents)
+    {
+        leftover -= cents;
+    }
+
+    // pass 3: write the balances, the first |leftover| accounts get one cent more (or less)
+    forEachBalanceChunk(numAccounts, numThreads, [&](int chunk, int begin, int end)
+                        { weights.forChunk(chunk, begin, end, [&](int slot, double weight)
+                                           {
+                                               Cents cents = static_cast<Cents>(std::floor(weight * centsPerWeight));
+                                               if (slot < leftover)
+                                                   cents += 1;
+                                               else if (slot < -leftover)
+                                                   cents -= 1;
+                                               set(slot + 1, cents); }); });
+}
+
+// Fills bankAccounts with the balances described by spec. Dense account stores are filled
+// in parallel (which also first-touches their pages from several threads); std::map is
+// filled by one thread because its inserts are not thread-safe.
+template <typename Accounts>
+void populateAccounts(Accounts &bankAccounts, const BalanceSpec &spec, int numAccounts)
+{
+    using Balance = BalanceOf<Accounts>;
+    int numThreads = IsAccountStore<Accounts>::value ? static_cast<int>(std::thread::hardware_concurrency()) : 1;
+    generateBalances(spec, numAccounts, numThreads, [&](int accountID, Cents cents)
+                     { bankAccounts[accountID] = fromCents<Balance>(cents); });
+}
+
+#endif
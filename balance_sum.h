@@ -0,0 +1,416 @@
+#ifndef BALANCE_SUM_H
+#define BALANCE_SUM_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "account_store.h"
+#include "balance_types.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BALANCE_SUM_X86 1
+#endif
+
+// Sums of many balances: single_balance() and the balance() of the engines that keep plain
+// balances in a packed store scan them with an explicitly vectorized kernel, chosen once at
+// run time for the best instruction set the CPU has (AVX-512, AVX2, SSE2). Cents are summed
+// exactly (int64 lanes, the same wraparound as the scalar loop). Floats are widened to double
+// and summed with Neumaier's compensated summation in every lane, so the total is the exact
+// sum rounded to float, however many accounts there are and whichever kernel ran.
+// Every other container (std::map, the padded store, atomics) goes through BalanceSum.
+
+// Instruction set of a summation kernel
+enum class SumKernel
+{
+    Scalar, // one balance at a time
+    Sse2,   // 128-bit lanes
+    Avx2,   // 256-bit lanes
+    Avx512  // 512-bit lanes (AVX-512F)
+};
+
+inline const char *sumKernelName(SumKernel kernel)
+{
+    switch (kernel)
+    {
+    case SumKernel::Scalar:
+        return "scalar";
+    case SumKernel::Sse2:
+        return "sse2";
+    case SumKernel::Avx2:
+        return "avx2";
+    case SumKernel::Avx512:
+        return "avx512";
+    }
+    return "unknown";
+}
+
+inline bool sumKernelSupported(SumKernel kernel)
+{
+#ifdef BALANCE_SUM_X86
+    switch (kernel)
+    {
+    case SumKernel::Scalar:
+        return true;
+    case SumKernel::Sse2:
+        return __builtin_cpu_supports("sse2");
+    case SumKernel::Avx2:
+        return __builtin_cpu_supports("avx2");
+    case SumKernel::Avx512:
+        return __builtin_cpu_supports("avx512f");
+    }
+    return false;
+#else
+    return kernel == SumKernel::Scalar;
+#endif
+}
+
+// The widest kernel this CPU runs, detected on the first call
+inline SumKernel bestSumKernel()
+{
+    static const SumKernel best = [] {
+        for (SumKernel kernel : {SumKernel::Avx512, SumKernel::Avx2, SumKernel::Sse2})
+        {
+            if (sumKernelSupported(kernel))
+            {
+                return kernel;
+            }
+        }
+        return SumKernel::Scalar;
+    }();
+    return best;
+}
+
+// Running total of balances: a plain sum for Cents; for float, Neumaier's compensated sum
+// in double (the compensation collects the low-order bits every addition rounds away),
+// rounded to float once at the end. The parts of a split scan are added as running totals,
+// so the whole scan is still rounded once
+template <typename Balance, bool Compensated = std::is_floating_point<Balance>::value>
+class BalanceSum
+{
+public:
+    void add(Balance value) { sum += value; }
+    void add(const BalanceSum &part) { sum += part.sum; }
+    Balance total() const { return sum; }
+
+private:
+    Balance sum = 0;
+};
+
+template <typename Balance>
+class BalanceSum<Balance, true>
+{
+public:
+    void add(double value)
+    {
+        double next = sum + value;
+        if (std::fabs(sum) >= std::fabs(value))
+        {
+            compensation += (sum - next) + value;
+        }
+        else
+        {
+            compensation += (value - next) + sum;
+        }
+        sum = next;
+    }
+
+    void add(const BalanceSum &part)
+    {
+        add(part.sum);
+        compensation += part.compensation;
+    }
+
+    Balance total() const { return static_cast<Balance>(sum + compensation); }
+
+private:
+    double sum = 0;
+    double compensation = 0;
+};
+
+namespace sum_kernels
+{
+    template <typename Balance>
+    BalanceSum<Balance> scalar(const Balance *values, std::size_t count)
+    {
+        BalanceSum<Balance> total;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            total.add(values[i]);
+        }
+        return total;
+    }
+
+    // Folds per-lane sums and compensations (and the tail the vectors did not cover) into one running total
+    inline BalanceSum<float> foldLanes(const double *sums, const double *compensations, std::size_t lanes, const float *tail, std::size_t tailCount)
+    {
+        BalanceSum<float> total;
+        double compensation = 0;
+        for (std::size_t lane = 0; lane < lanes; ++lane)
+        {
+            total.add(sums[lane]);
+            compensation += compensations[lane];
+        }
+        for (std::size_t i = 0; i < tailCount; ++i)
+        {
+            total.add(tail[i]);
+        }
+        total.add(compensation);
+        return total;
+    }
+
+#ifdef BALANCE_SUM_X86
+    // Several independent accumulators per kernel hide the latency of the adds
+
+    __attribute__((target("sse2"))) inline Cents sse2(const Cents *values, std::size_t count)
+    {
+        __m128i acc[4] = {_mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128()};
+        std::size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            for (int k = 0; k < 4; ++k)
+            {
+                acc[k] = _mm_add_epi64(acc[k], _mm_loadu_si128(reinterpret_cast<const __m128i *>(values + i + 2 * k)));
+            }
+        }
+        alignas(16) Cents lanes[2];
+        _mm_store_si128(reinterpret_cast<__m128i *>(lanes), _mm_add_epi64(_mm_add_epi64(acc[0], acc[1]), _mm_add_epi64(acc[2], acc[3])));
+        Cents total = lanes[0] + lanes[1];
+        for (; i < count; ++i)
+        {
+            total += values[i];
+        }
+        return total;
+    }
+
+    __attribute__((target("avx2"))) inline Cents avx2(const Cents *values, std::size_t count)
+    {
+        __m256i acc[4] = {_mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256()};
+        std::size_t i = 0;
+        for (; i + 16 <= count; i += 16)
+        {
+            for (int k = 0; k < 4; ++k)
+            {
+                acc[k] = _mm256_add_epi64(acc[k], _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + i + 4 * k)));
+            }
+        }
+        alignas(32) Cents lanes[4];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), _mm256_add_epi64(_mm256_add_epi64(acc[0], acc[1]), _mm256_add_epi64(acc[2], acc[3])));
+        Cents total = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        for (; i < count; ++i)
+        {
+            total += values[i];
+        }
+        return total;
+    }
+
+    __attribute__((target("avx512f"))) inline Cents avx512(const Cents *values, std::size_t count)
+    {
+        __m512i acc[4] = {_mm512_setzero_si512(), _mm512_setzero_si512(), _mm512_setzero_si512(), _mm512_setzero_si512()};
+        std::size_t i = 0;
+        for (; i + 32 <= count; i += 32)
+        {
+            for (int k = 0; k < 4; ++k)
+            {
+                acc[k] = _mm512_add_epi64(acc[k], _mm512_loadu_si512(values + i + 8 * k));
+            }
+        }
+        alignas(64) Cents lanes[8];
+        _mm512_store_si512(lanes, _mm512_add_epi64(_mm512_add_epi64(acc[0], acc[1]), _mm512_add_epi64(acc[2], acc[3])));
+        Cents total = 0;
+        for (Cents lane : lanes)
+        {
+            total += lane;
+        }
+        for (; i < count; ++i)
+        {
+            total += values[i];
+        }
+        return total;
+    }
+
+    // Floats are widened to double lanes, which hold every float exactly, and each lane runs
+    // Neumaier's step: the larger of sum and value (by magnitude) minus the new sum, plus the
+    // smaller, is what the addition rounded away
+
+    __attribute__((target("sse2"))) inline BalanceSum<float> sse2(const float *values, std::size_t count)
+    {
+        const __m128d magnitude = _mm_castsi128_pd(_mm_set1_epi64x(0x7fffffffffffffffLL));
+        __m128d sum[2] = {_mm_setzero_pd(), _mm_setzero_pd()};
+        __m128d comp[2] = {_mm_setzero_pd(), _mm_setzero_pd()};
+        std::size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 four = _mm_loadu_ps(values + i);
+            __m128d halves[2] = {_mm_cvtps_pd(four), _mm_cvtps_pd(_mm_movehl_ps(four, four))};
+            for (int k = 0; k < 2; ++k)
+            {
+                __m128d next = _mm_add_pd(sum[k], halves[k]);
+                __m128d sumIsLarger = _mm_cmpge_pd(_mm_and_pd(sum[k], magnitude), _mm_and_pd(halves[k], magnitude));
+                __m128d larger = _mm_or_pd(_mm_and_pd(sumIsLarger, sum[k]), _mm_andnot_pd(sumIsLarger, halves[k]));
+                __m128d smaller = _mm_or_pd(_mm_and_pd(sumIsLarger, halves[k]), _mm_andnot_pd(sumIsLarger, sum[k]));
+                comp[k] = _mm_add_pd(comp[k], _mm_add_pd(_mm_sub_pd(larger, next), smaller));
+                sum[k] = next;
+            }
+        }
+        alignas(16) double sums[4], compensations[4];
+        for (int k = 0; k < 2; ++k)
+        {
+            _mm_store_pd(sums + 2 * k, sum[k]);
+            _mm_store_pd(compensations + 2 * k, comp[k]);
+        }
+        return foldLanes(sums, compensations, 4, values + i, count - i);
+    }
+
+    __attribute__((target("avx2"))) inline BalanceSum<float> avx2(const float *values, std::size_t count)
+    {
+        const __m256d magnitude = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+        __m256d sum[2] = {_mm256_setzero_pd(), _mm256_setzero_pd()};
+        __m256d comp[2] = {_mm256_setzero_pd(), _mm256_setzero_pd()};
+        std::size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            for (int k = 0; k < 2; ++k)
+            {
+                __m256d value = _mm256_cvtps_pd(_mm_loadu_ps(values + i + 4 * k));
+                __m256d next = _mm256_add_pd(sum[k], value);
+                __m256d sumIsLarger = _mm256_cmp_pd(_mm256_and_pd(sum[k], magnitude), _mm256_and_pd(value, magnitude), _CMP_GE_OQ);
+                __m256d larger = _mm256_blendv_pd(value, sum[k], sumIsLarger);
+                __m256d smaller = _mm256_blendv_pd(sum[k], value, sumIsLarger);
+                comp[k] = _mm256_add_pd(comp[k], _mm256_add_pd(_mm256_sub_pd(larger, next), smaller));
+                sum[k] = next;
+            }
+        }
+        alignas(32) double sums[8], compensations[8];
+        for (int k = 0; k < 2; ++k)
+        {
+            _mm256_store_pd(sums + 4 * k, sum[k]);
+            _mm256_store_pd(compensations + 4 * k, comp[k]);
+        }
+        return foldLanes(sums, compensations, 8, values + i, count - i);
+    }
+
+    __attribute__((target("avx512f"))) inline BalanceSum<float> avx512(const float *values, std::size_t count)
+    {
+        __m512d sum[2] = {_mm512_setzero_pd(), _mm512_setzero_pd()};
+        __m512d comp[2] = {_mm512_setzero_pd(), _mm512_setzero_pd()};
+        std::size_t i = 0;
+        for (; i + 16 <= count; i += 16)
+        {
+            for (int k = 0; k < 2; ++k)
+            {
+                __m512d value = _mm512_maskz_cvtps_pd(0xff, _mm256_loadu_ps(values + i + 8 * k)); // all lanes (GCC 12 warns on the unmasked form)
+                __m512d next = _mm512_add_pd(sum[k], value);
+                __mmask8 sumIsLarger = _mm512_cmp_pd_mask(_mm512_abs_pd(sum[k]), _mm512_abs_pd(value), _CMP_GE_OQ);
+                __m512d larger = _mm512_mask_blend_pd(sumIsLarger, value, sum[k]);
+                __m512d smaller = _mm512_mask_blend_pd(sumIsLarger, sum[k], value);
+                comp[k] = _mm512_add_pd(comp[k], _mm512_add_pd(_mm512_sub_pd(larger, next), smaller));
+                sum[k] = next;
+            }
+        }
+        alignas(64) double sums[16], compensations[16];
+        for (int k = 0; k < 2; ++k)
+        {
+            _mm512_store_pd(sums + 8 * k, sum[k]);
+            _mm512_store_pd(compensations + 8 * k, comp[k]);
+        }
+        return foldLanes(sums, compensations, 16, values + i, count - i);
+    }
+#endif
+} // namespace sum_kernels
+
+// Running total of count contiguous balances with the given kernel (one the CPU supports)
+template <typename Balance>
+BalanceSum<Balance> partialSumBalances(const Balance *values, std::size_t count, SumKernel kernel)
+{
+    static_assert(std::is_same<Balance, Cents>::value || std::is_same<Balance, float>::value, "no summation kernel for this balance type");
+    BalanceSum<Balance> total;
+#ifdef BALANCE_SUM_X86
+    switch (kernel)
+    {
+    case SumKernel::Scalar:
+        break;
+    case SumKernel::Sse2:
+        total.add(sum_kernels::sse2(values, count));
+        return total;
+    case SumKernel::Avx2:
+        total.add(sum_kernels::avx2(values, count));
+        return total;
+    case SumKernel::Avx512:
+        total.add(sum_kernels::avx512(values, count));
+        return total;
+    }
+#else
+    (void)kernel;
+#endif
+    total.add(sum_kernels::scalar(values, count));
+    return total;
+}
+
+// Sum of count contiguous balances with the given kernel (one the CPU supports)
+template <typename Balance>
+Balance sumBalances(const Balance *values, std::size_t count, SumKernel kernel)
+{
+    return partialSumBalances(values, count, kernel).total();
+}
+
+template <typename Balance>
+Balance sumBalances(const Balance *values, std::size_t count)
+{
+    return sumBalances(values, count, bestSumKernel());
+}
+
+// Sum of every balance in an account container: the vectorized kernel for a packed store of
+// plain balances, BalanceSum over the entries for everything else
+template <typename Accounts>
+BalanceOf<Accounts> sumBalances(const Accounts &bankAccounts)
+{
+    BalanceSum<BalanceOf<Accounts>> total;
+    for (const auto &account : bankAccounts)
+    {
+        total.add(loadBalance(account.second));
+    }
+    return total.total();
+}
+
+template <typename Balance>
+typename std::enable_if<std::is_arithmetic<Balance>::value, Balance>::type sumBalances(const PackedAccountStore<Balance> &bankAccounts)
+{
+    static_assert(sizeof(PackedCell<Balance>) == sizeof(Balance), "packed cells must be back to back");
+    if (bankAccounts.size() == 0)
+    {
+        return 0;
+    }
+    return sumBalances(&bankAccounts[1], static_cast<std::size_t>(bankAccounts.size()));
+}
+
+// Running total of the balances of the accounts first..last (inclusive), the same way: one
+// part of a scan split into ranges (audit_pool.h)
+template <typename Accounts>
+BalanceSum<BalanceOf<Accounts>> partialSumBalances(const Accounts &bankAccounts, int first, int last)
+{
+    BalanceSum<BalanceOf<Accounts>> total;
+    forEachAccount(bankAccounts, first, last, [&](int, const auto &balance)
+                   {
+                       total.add(loadBalance(balance));
+                       return true; });
+    return total;
+}
+
+template <typename Balance>
+typename std::enable_if<std::is_arithmetic<Balance>::value, BalanceSum<Balance>>::type partialSumBalances(const PackedAccountStore<Balance> &bankAccounts, int first, int last)
+{
+    return first > last ? BalanceSum<Balance>() : partialSumBalances(&bankAccounts[first], static_cast<std::size_t>(last - first + 1), bestSumKernel());
+}
+
+// Sum of the balances of the accounts first..last (inclusive)
+template <typename Accounts>
+BalanceOf<Accounts> sumBalances(const Accounts &bankAccounts, int first, int last)
+{
+    return partialSumBalances(bankAccounts, first, last).total();
+}
+
+#endif
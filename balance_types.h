@@ -0,0 +1,134 @@
+#ifndef BALANCE_TYPES_H
+#define BALANCE_TYPES_H
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+// Fixed-point balance in minor units (1 = one cent). Sums are exact at any account count
+// and std::atomic<Cents> supports native fetch_add / compare_exchange.
+using Cents = std::int64_t;
+
+enum class BalanceType
+{
+    Float, // the original float dollars
+    Cents  // int64 cents
+};
+
+template <typename T>
+struct BalanceValue
+{
+    using type = T;
+};
+
+template <typename T>
+struct BalanceValue<std::atomic<T>>
+{
+    using type = T;
+};
+
+// Balance type stored in an account container (std::map or AccountStore), with
+// std::atomic<> stripped for the engines that keep their accounts in atomics
+template <typename Accounts>
+using BalanceOf = typename BalanceValue<typename Accounts::mapped_type>::type;
+
+template <typename Balance>
+Balance toBalance(double dollars)
+{
+    if constexpr (std::is_integral<Balance>::value)
+        return static_cast<Balance>(std::llround(dollars * 100.0));
+    else
+        return static_cast<Balance>(dollars);
+}
+
+template <typename Balance>
+Balance fromCents(Cents cents)
+{
+    if constexpr (std::is_integral<Balance>::value)
+        return static_cast<Balance>(cents);
+    else
+        return static_cast<Balance>(static_cast<double>(cents) / 100.0);
+}
+
+template <typename Balance>
+double toDollars(Balance balance)
+{
+    if constexpr (std::is_integral<Balance>::value)
+        return static_cast<double>(balance) / 100.0;
+    else
+        return static_cast<double>(balance);
+}
+
+// Atomically adds amount to an account: a single fetch_add for Cents, a CAS loop for
+// float (std::atomic<float> has no fetch_add before C++20)
+template <typename Balance>
+void atomicAddBalance(std::atomic<Balance> &account, Balance amount)
+{
+    if constexpr (std::is_integral<Balance>::value)
+    {
+        account.fetch_add(amount, std::memory_order_relaxed);
+    }
+    else
+    {
+        Balance current = account.load(std::memory_order_relaxed);
+        while (!account.compare_exchange_weak(current, current + amount, std::memory_order_relaxed))
+        {
+        }
+    }
+}
+
+// Reads and writes an account whether or not it is a std::atomic. Relaxed, so only for code
+// that runs while no other thread touches the account (populating, single-threaded runs).
+template <typename Balance>
+Balance loadBalance(const Balance &account)
+{
+    return account;
+}
+
+template <typename Balance>
+Balance loadBalance(const std::atomic<Balance> &account)
+{
+    return account.load(std::memory_order_relaxed);
+}
+
+template <typename Balance>
+void storeBalance(Balance &account, Balance value)
+{
+    account = value;
+}
+
+template <typename Balance>
+void storeBalance(std::atomic<Balance> &account, Balance value)
+{
+    account.store(value, std::memory_order_relaxed);
+}
+
+inline bool parseBalanceType(const std::string &name, BalanceType &type)
+{
+    if (name == "float")
+        type = BalanceType::Float;
+    else if (name == "cents")
+        type = BalanceType::Cents;
+    else
+        return false;
+    return true;
+}
+
+inline const char *balanceTypeName(BalanceType type)
+{
+    return type == BalanceType::Float ? "float" : "cents";
+}
+
+// Calls fn with a zero of the chosen balance type, so a generic lambda can recover it
+// with "using Balance = decltype(zero);"
+template <typename Fn>
+int withBalanceType(BalanceType type, Fn &&fn)
+{
+    if (type == BalanceType::Float)
+        return fn(0.0f);
+    return fn(Cents{0});
+}
+
+#endif
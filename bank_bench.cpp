@@ -0,0 +1,877 @@
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <map>
+#include <cstdlib>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <thread>
+#include <chrono>
+#include <future>
+#include <memory>
+
+#include "account_store.h"
+#include "balance_generator.h"
+#include "balance_types.h"
+#include "bank_options.h"
+#include "checkpoint.h"
+#include "engine.h"
+#include "engine_coarse.h"
+#include "engine_combining.h"
+#include "engine_delegation.h"
+#include "engine_escrow.h"
+#include "engine_fast.h"
+#include "engine_fine.h"
+#include "engine_lockfree.h"
+#include "engine_mvcc.h"
+#include "engine_none.h"
+#include "engine_seqlock.h"
+#include "engine_subtotal.h"
+#include "engine_unique.h"
+#include "latency.h"
+#include "lock_profiler.h"
+#include "placement.h"
+#include "trace.h"
+#include "wal.h"
+#include "workload.h"
+
+// One benchmark harness for every engine: the accounts, the workload, the threads and the
+// timing are the same for all of them, so results only differ in the synchronization strategy.
+
+struct EngineInfo
+{
+    const char *name;
+    const char *description;
+    bool usesLockStripes; // honours --lock-stripes
+    int (*run)(const BankOptions &options);
+};
+
+// What one run measured, for the csv/json output
+struct BenchResult
+{
+    float maxExecutionTime = 0.0f;
+    float singleExecutionTime = 0.0f;
+    std::string workload;
+    std::string topology; // the machine, and where the workers and the shared memory were placed
+    std::string affinity;
+    std::string numa;
+    EngineReport report; // engine counters, plus the harness's consistency errors
+    bool measuredLatency = false;
+    std::uint64_t timerOverhead = 0;                       // nanoseconds, already subtracted from the histograms
+    std::array<LatencyHistogram, NUM_OP_TYPES> latencies; // merged over all workers, indexed by OpType
+};
+
+// One worker's latency histograms, indexed by OpType
+using WorkerLatencies = std::array<LatencyHistogram, NUM_OP_TYPES>;
+
+// Keeps a balance() total the workload never reads, so the compiler cannot drop the scan
+// behind it (it did for the inlined loops of the plain-account engines)
+template <typename Balance>
+void keepBalance(Balance total)
+{
+    asm volatile("" : : "g"(total));
+}
+
+template <typename Accounts>
+float single_do_work(Accounts &bankAccounts, const OperationSource<BalanceOf<Accounts>> &source, int numIterations)
+{
+    // generate (or map) every operation before the timer starts
+    WorkerOperations<BalanceOf<Accounts>> operations = source.forWorker(0, 1, numIterations);
+    OperationBatch<BalanceOf<Accounts>> batch;
+
+    auto loop_start = std::chrono::high_resolution_clock::now();
+    while (operations.next(batch))
+    {
+        for (const auto &op : batch)
+        {
+            if (op.type == OpType::Deposit) // deposit (95% of the operations by default, see --mix)
+            {
+                // perform deposit transaction
+                single_deposit(bankAccounts, op.from, op.to, op.amount);
+            }
+            else if (op.type == OpType::GetBalance) // one account (0% by default)
+            {
+                keepBalance(single_get_balance(bankAccounts, op.from));
+            }
+            else if (op.type == OpType::RangeBalance) // accounts op.from..op.to (0% by default)
+            {
+                keepBalance(single_range_balance(bankAccounts, op.from, op.to));
+            }
+            else // balance check
+            {
+                keepBalance(single_balance(bankAccounts));
+            }
+        }
+    }
+
+    auto loop_end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<float>(loop_end - loop_start).count();
+}
+
+// latencies == nullptr: only the whole loop is timed. With batchSize > 1 every run of up to
+// batchSize consecutive deposits goes to depositBatch() (and is timed as one deposit). With a
+// --wal every applied deposit returns once it is durable in the log. With a --checkpoint
+// every operation passes its gate, and worker 0 takes it halfway through its operations.
+// firstDeposit receives when the worker's first deposit returned.
+template <typename Engine, typename Balance, typename Checkpoint>
+float do_work(Engine &engine, const OperationSource<Balance> &source, int worker, int numIterations, int numThreads,
+              int batchSize, WriteAheadLog<Balance> *wal, Checkpoint *checkpointer, WorkerLatencies *latencies,
+              std::uint64_t timerOverhead, std::chrono::steady_clock::time_point &firstDeposit)
+{
+    // each worker generates its own reproducible stream of operations (or takes its part of
+    // the --trace) before the timer starts, so the timed loop measures only synchronization
+    // and account access
+    WorkerOperations<Balance> operations = source.forWorker(worker, numThreads, numIterations);
+    OperationBatch<Balance> batch;
+
+    bool deposited = false;
+    auto noteDeposit = [&]
+    {
+        if (!deposited)
+        {
+            firstDeposit = std::chrono::steady_clock::now();
+            deposited = true;
+        }
+    };
+
+    // operations done so far, and after how many of them worker 0 takes the checkpoint
+    std::size_t served = 0;
+    const std::size_t checkpointAt = operations.expectedCount(numThreads) / 2;
+    auto gated = [&](std::size_t numOps, auto &&call)
+    {
+        if (checkpointer == nullptr)
+        {
+            call();
+            return;
+        }
+        if (worker == 0 && served >= checkpointAt && !checkpointer->wasTaken())
+        {
+            checkpointer->take();
+        }
+        checkpointer->enter(worker);
+        call();
+        checkpointer->leave(worker);
+        served += numOps;
+    };
+
+    auto apply = [&](const Operation<Balance> &op)
+    {
+        if (op.type == OpType::Deposit) // deposit (95% of the operations by default, see --mix)
+        {
+            // Perform the deposit operation
+            durableDeposit(engine, wal, worker, op);
+            noteDeposit();
+        }
+        else if (op.type == OpType::GetBalance) // one account (0% by default)
+        {
+            keepBalance(engine.get_balance(worker, op.from));
+        }
+        else if (op.type == OpType::RangeBalance) // accounts op.from..op.to (0% by default)
+        {
+            keepBalance(engine.range_balance(worker, op.from, op.to));
+        }
+        else // balance
+        {
+            keepBalance(engine.balance(worker));
+        }
+    };
+    auto run = [&](const Operation<Balance> &op)
+    {
+        gated(1, [&]
+              { apply(op); });
+    };
+    auto runBatch = [&](OperationBatch<Balance> transfers)
+    {
+        gated(static_cast<std::size_t>(transfers.last - transfers.first), [&]
+              { depositBatch(engine, worker, transfers, 0); });
+        noteDeposit();
+    };
+
+    auto timed = [&](OpType type, auto &&call)
+    {
+        LatencyClock::time_point start = LatencyClock::now();
+        call();
+        std::uint64_t elapsed = nanosecondsBetween(start, LatencyClock::now());
+        (*latencies)[static_cast<int>(type)].record(elapsed > timerOverhead ? elapsed - timerOverhead : 0);
+    };
+
+    auto loop_start = std::chrono::high_resolution_clock::now();
+    while (operations.next(batch))
+    {
+        if (batchSize > 1)
+        {
+            for (const Operation<Balance> *op = batch.begin(); op != batch.end();)
+            {
+                if (op->type != OpType::Deposit)
+                {
+                    if (latencies == nullptr)
+                        run(*op);
+                    else
+                        timed(op->type, [&]
+                              { run(*op); });
+                    ++op;
+                    continue;
+                }
+                // the run of deposits starting here, at most batchSize long
+                OperationBatch<Balance> transfers{op, op};
+                while (transfers.last != batch.end() && transfers.last - op < batchSize && transfers.last->type == OpType::Deposit)
+                {
+                    ++transfers.last;
+                }
+                if (latencies == nullptr)
+                    runBatch(transfers);
+                else
+                    timed(OpType::Deposit, [&]
+                          { runBatch(transfers); });
+                op = transfers.last;
+            }
+            continue;
+        }
+        if (latencies == nullptr)
+        {
+            for (const auto &op : batch)
+            {
+                run(op);
+            }
+            continue;
+        }
+        for (const auto &op : batch)
+        {
+            timed(op.type, [&]
+                  { run(op); });
+        }
+    }
+    if (checkpointer != nullptr && worker == 0 && !checkpointer->wasTaken())
+    {
+        checkpointer->take(); // no operations, or fewer than its share of a shared trace (--trace-mode=shared)
+    }
+    finishWorker(engine, worker, 0); // delegating engines finish the work handed to other threads
+
+    auto loop_end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<float>(loop_end - loop_start).count();
+}
+
+// When the process started, for the time to the first transfer
+const std::chrono::steady_clock::time_point PROGRAM_START = std::chrono::steady_clock::now();
+
+// CSV field, quoted when it contains a separator
+std::string csvField(const std::string &value)
+{
+    if (value.find_first_of(",\"") == std::string::npos)
+    {
+        return value;
+    }
+    std::string quoted = "\"";
+    for (char c : value)
+    {
+        quoted += c == '"' ? "\"\"" : std::string(1, c);
+    }
+    return quoted + "\"";
+}
+
+std::string jsonString(const std::string &value)
+{
+    std::string quoted = "\"";
+    for (char c : value)
+    {
+        if (c == '"' || c == '\\')
+        {
+            quoted += '\\';
+        }
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+// The profiled locks, hottest (longest total wait) first
+std::vector<LockProfile> hottestLocks(const std::vector<LockProfile> &locks, std::size_t count)
+{
+    std::vector<LockProfile> hottest;
+    for (const auto &lock : locks)
+    {
+        if (lock.stats.acquisitions > 0)
+        {
+            hottest.push_back(lock);
+        }
+    }
+    std::sort(hottest.begin(), hottest.end(), [](const LockProfile &a, const LockProfile &b)
+              { return a.stats.waitNs != b.stats.waitNs ? a.stats.waitNs > b.stats.waitNs : a.stats.contended > b.stats.contended; });
+    if (hottest.size() > count)
+    {
+        hottest.resize(count);
+    }
+    return hottest;
+}
+
+// Accounts protected by a lock table stripe, e.g. "account 12" or "accounts 12, 76, ... (4 accounts)"
+std::string stripeAccounts(std::size_t stripe, std::size_t numStripes, int numAccounts)
+{
+    std::vector<std::size_t> accounts;
+    std::size_t total = 0;
+    for (std::size_t account = stripe == 0 ? numStripes : stripe; account <= static_cast<std::size_t>(numAccounts); account += numStripes)
+    {
+        if (accounts.size() < 2)
+        {
+            accounts.push_back(account);
+        }
+        ++total;
+    }
+    std::ostringstream description;
+    if (total == 0)
+        description << "no accounts";
+    else if (total == 1)
+        description << "account " << accounts[0];
+    else
+        description << "accounts " << accounts[0] << ", " << accounts[1] << (total > 2 ? ", ..." : "") << " (" << total << " accounts)";
+    return description.str();
+}
+
+// Lock contention report for --profile-locks: the hottest locks, then one heatmap cell per
+// account (or per group of accounts when there are more than 1000) shaded by how many
+// contended acquisitions its stripe saw
+void printLockProfile(const std::vector<LockProfile> &locks, int numAccounts)
+{
+    std::size_t numStripes = 0;
+    for (const auto &lock : locks)
+    {
+        numStripes += lock.stripe != NOT_A_STRIPE ? 1 : 0;
+    }
+
+    if (locks.empty())
+    {
+        std::cout << "Locks: none (this engine takes no locks)\n";
+        return;
+    }
+    std::cout << "Hottest locks (acquisitions, contended, wait, hold):\n";
+    for (const auto &lock : hottestLocks(locks, 10))
+    {
+        std::cout << "  " << lock.name;
+        if (lock.stripe != NOT_A_STRIPE)
+        {
+            std::cout << " [" << stripeAccounts(lock.stripe, numStripes, numAccounts) << "]";
+        }
+        std::cout << ": " << lock.stats.acquisitions << ", " << lock.stats.contended << " ("
+                  << (100.0 * lock.stats.contended / lock.stats.acquisitions) << "%), "
+                  << lock.stats.waitNs / 1e6 << " ms, " << lock.stats.holdNs / 1e6 << " ms\n";
+    }
+    if (numStripes == 0)
+    {
+        return;
+    }
+
+    // contended acquisitions of the stripe protecting each account
+    std::vector<std::uint64_t> contended(numStripes, 0);
+    for (const auto &lock : locks)
+    {
+        if (lock.stripe != NOT_A_STRIPE)
+        {
+            contended[lock.stripe] = lock.stats.contended;
+        }
+    }
+    const int MAX_CELLS = 1000;
+    const int CELLS_PER_ROW = 50;
+    const char SHADES[] = " .:-=+*#%@";
+    int accountsPerCell = (numAccounts + MAX_CELLS - 1) / MAX_CELLS;
+    int numCells = (numAccounts + accountsPerCell - 1) / accountsPerCell;
+    std::vector<std::uint64_t> cells(numCells, 0);
+    for (int account = 1; account <= numAccounts; ++account)
+    {
+        std::uint64_t &cell = cells[(account - 1) / accountsPerCell];
+        cell = std::max(cell, contended[static_cast<std::size_t>(account) & (numStripes - 1)]);
+    }
+    std::uint64_t hottest = *std::max_element(cells.begin(), cells.end());
+
+    std::cout << "Contention heatmap (" << accountsPerCell << " account" << (accountsPerCell > 1 ? "s" : "")
+              << " per cell, '" << SHADES[1] << "' = least to '" << SHADES[9] << "' = " << hottest << " contended acquisitions):\n";
+    for (int row = 0; row < numCells; row += CELLS_PER_ROW)
+    {
+        int first = row * accountsPerCell + 1;
+        int last = std::min(numAccounts, (row + CELLS_PER_ROW) * accountsPerCell);
+        std::ostringstream label;
+        label << first << "-" << last;
+        std::cout << "  " << label.str() << std::string(label.str().size() < 20 ? 20 - label.str().size() : 1, ' ') << "|";
+        for (int cell = row; cell < std::min(numCells, row + CELLS_PER_ROW); ++cell)
+        {
+            int shade = hottest == 0 || cells[cell] == 0 ? 0 : 1 + static_cast<int>(8 * cells[cell] / hottest);
+            std::cout << SHADES[shade];
+        }
+        std::cout << "|\n";
+    }
+}
+
+// The wal column: the --wal-sync of the log, or off
+std::string walName(const BankOptions &options)
+{
+    return options.walFile.empty() ? "off" : walSyncName(options.walSync);
+}
+
+void printResult(const BankOptions &options, const EngineInfo &engine, const BenchResult &result)
+{
+    float maxMs = result.maxExecutionTime * 1000;
+    float singleMs = result.singleExecutionTime * 1000;
+    float speedup = result.singleExecutionTime / result.maxExecutionTime;
+    std::size_t lockStripes = engine.usesLockStripes ? options.lockStripes : 0;
+    bool consistent = result.report.errors.empty();
+
+    if (options.output == OutputFormat::Csv)
+    {
+        std::string counters;
+        for (const auto &counter : result.report.counters)
+        {
+            std::ostringstream field;
+            field << (counters.empty() ? "" : ";") << counter.first << "=" << counter.second;
+            counters += field.str();
+        }
+        // latency columns are left empty without --latency
+        std::string latencyHeader;
+        std::ostringstream latencyFields;
+        for (OpType type : ALL_OP_TYPES)
+        {
+            const LatencyHistogram &histogram = result.latencies[static_cast<int>(type)];
+            std::string name = opTypeName(type);
+            latencyHeader += "," + name + "_p50_ns," + name + "_p99_ns," + name + "_p999_ns," + name + "_max_ns";
+            if (result.measuredLatency && histogram.count() > 0)
+                latencyFields << "," << histogram.percentile(0.5) << "," << histogram.percentile(0.99) << ","
+                              << histogram.percentile(0.999) << "," << histogram.max();
+            else
+                latencyFields << ",,,,";
+        }
+        std::cout << "engine,accounts,threads,iterations,store,balance,balances,lock_stripes,batch,audit_threads,wal,wal_group,wal_wait_us,restored,workload,topology,affinity,numa,max_ms,single_ms,speedup,consistent,counters"
+                  << latencyHeader << "\n"
+                  << engine.name << "," << options.numAccounts << "," << options.numThreads << "," << options.numIterations
+                  << "," << storeLayoutName(options.store) << "," << balanceTypeName(options.balanceType)
+                  << "," << balanceDistributionName(options.balances.distribution) << "," << lockStripes
+                  << "," << options.batchSize << "," << options.auditThreads << "," << walName(options)
+                  << "," << options.walGroup << "," << options.walWaitUs << "," << (options.restoreFile.empty() ? "false" : "true")
+                  << "," << csvField(result.workload) << "," << csvField(result.topology) << "," << csvField(result.affinity)
+                  << "," << csvField(result.numa) << "," << maxMs << "," << singleMs << "," << speedup
+                  << "," << (consistent ? "true" : "false") << "," << csvField(counters) << latencyFields.str() << std::endl;
+    }
+    else if (options.output == OutputFormat::Json)
+    {
+        std::cout << "{\"engine\": " << jsonString(engine.name) << ", \"accounts\": " << options.numAccounts
+                  << ", \"threads\": " << options.numThreads << ", \"iterations\": " << options.numIterations
+                  << ", \"store\": " << jsonString(storeLayoutName(options.store))
+                  << ", \"balance\": " << jsonString(balanceTypeName(options.balanceType))
+                  << ", \"balances\": " << jsonString(balanceDistributionName(options.balances.distribution))
+                  << ", \"lock_stripes\": " << lockStripes << ", \"batch\": " << options.batchSize
+                  << ", \"audit_threads\": " << options.auditThreads << ", \"wal\": " << jsonString(walName(options))
+                  << ", \"wal_group\": " << options.walGroup << ", \"wal_wait_us\": " << options.walWaitUs
+                  << ", \"restored\": " << (options.restoreFile.empty() ? "false" : "true") << ", \"workload\": " << jsonString(result.workload)
+                  << ", \"topology\": " << jsonString(result.topology) << ", \"affinity\": " << jsonString(result.affinity)
+                  << ", \"numa\": " << jsonString(result.numa)
+                  << ", \"max_ms\": " << maxMs << ", \"single_ms\": " << singleMs << ", \"speedup\": " << speedup
+                  << ", \"consistent\": " << (consistent ? "true" : "false") << ", \"counters\": {";
+        for (std::size_t i = 0; i < result.report.counters.size(); ++i)
+        {
+            std::cout << (i == 0 ? "" : ", ") << jsonString(result.report.counters[i].first) << ": " << result.report.counters[i].second;
+        }
+        std::cout << "}, \"errors\": [";
+        for (std::size_t i = 0; i < result.report.errors.size(); ++i)
+        {
+            std::cout << (i == 0 ? "" : ", ") << jsonString(result.report.errors[i]);
+        }
+        std::cout << "]";
+        if (options.profileLocks)
+        {
+            std::cout << ", \"hot_locks\": [";
+            std::vector<LockProfile> hottest = hottestLocks(result.report.locks, 10);
+            for (std::size_t i = 0; i < hottest.size(); ++i)
+            {
+                const LockStats &stats = hottest[i].stats;
+                std::cout << (i == 0 ? "" : ", ") << "{\"name\": " << jsonString(hottest[i].name) << ", \"acquisitions\": " << stats.acquisitions
+                          << ", \"contended\": " << stats.contended << ", \"wait_ns\": " << stats.waitNs << ", \"hold_ns\": " << stats.holdNs << "}";
+            }
+            std::cout << "]";
+        }
+        if (result.measuredLatency)
+        {
+            std::cout << ", \"latency\": {\"timer_overhead_ns\": " << result.timerOverhead;
+            for (OpType type : ALL_OP_TYPES)
+            {
+                const LatencyHistogram &histogram = result.latencies[static_cast<int>(type)];
+                std::cout << ", " << jsonString(opTypeName(type)) << ": {\"count\": " << histogram.count()
+                          << ", \"p50_ns\": " << histogram.percentile(0.5) << ", \"p99_ns\": " << histogram.percentile(0.99)
+                          << ", \"p999_ns\": " << histogram.percentile(0.999) << ", \"max_ns\": " << histogram.max() << "}";
+            }
+            std::cout << "}";
+        }
+        std::cout << "}" << std::endl;
+    }
+    else
+    {
+        for (const auto &counter : result.report.counters)
+        {
+            std::cout << counter.first << ": " << counter.second << "\n";
+        }
+        if (options.profileLocks)
+        {
+            printLockProfile(result.report.locks, options.numAccounts);
+        }
+        if (result.measuredLatency)
+        {
+            std::cout << "Latency (timer overhead of " << result.timerOverhead << " ns subtracted):\n";
+            for (OpType type : ALL_OP_TYPES)
+            {
+                const LatencyHistogram &histogram = result.latencies[static_cast<int>(type)];
+                if (histogram.count() == 0)
+                    continue;
+                std::cout << "  " << opTypeName(type) << "(): " << histogram.count() << " calls, p50 = " << histogram.percentile(0.5)
+                          << " ns, p99 = " << histogram.percentile(0.99) << " ns, p99.9 = " << histogram.percentile(0.999)
+                          << " ns, max = " << histogram.max() << " ns\n";
+            }
+        }
+        std::cout << "\nMax multi-threaded execution time: " << maxMs << " milliseconds\n";
+        std::cout << "Single-threaded execution time:    " << singleMs << " milliseconds\n";
+        // calculate and print the performance difference
+        if (speedup > 1)
+        {
+            std::cout << "\nThe multi-threaded performance is " << speedup << " times faster than the single-threaded performance.\n\n";
+        }
+        else
+        {
+            std::cout << "\nThe multi-threaded performance is " << (1 / speedup) << " times slower than the single-threaded performance.\n\n";
+        }
+        std::cout << "<----------------------------------------------------------------------->" << std::endl;
+    }
+}
+
+template <typename Engine, typename Accounts>
+int runBank(Accounts &bankAccounts, const BankOptions &options, const EngineInfo &info, const Placement &placement,
+            CheckpointFile<BalanceOf<Accounts>> &restore)
+{
+    const int NUM_ACCOUNTS = options.numAccounts;
+    const int NUM_THREADS = options.numThreads;
+    const int NUM_ITERATIONS = options.numIterations;
+    using Balance = BalanceOf<Accounts>;
+
+    // the text report goes to stdout; with --output=csv|json only the result row does, and errors go to stderr
+    std::ostream text(options.output == OutputFormat::Text ? std::cout.rdbuf() : nullptr);
+    BenchResult result;
+    auto reportError = [&](const std::string &message)
+    {
+        result.report.errors.push_back(message);
+        (options.output == OutputFormat::Text ? std::cout : std::cerr) << "Error: " << message << std::endl;
+    };
+
+    // Step 2: bankAccounts maps each account's unique ID (int) to its balance (float dollars or int64 cents, see --balance), stored in the layout chosen with --store
+    text << std::endl;
+
+    if (restore.isOpen())
+    {
+        // Step 2.0: with --restore, start from the checkpoint's balances (a packed store already serves them from the mapping,
+        // the others copy them in); they are not summed here, which would read every page of the checkpoint
+        if (options.store != StoreLayout::Packed)
+        {
+            restore.copyTo(bankAccounts);
+        }
+        text << "Restored " << NUM_ACCOUNTS << " accounts from checkpoint " << restore.file() << " (LSN " << restore.lsn() << ")" << std::endl;
+    }
+    else
+    {
+        // Step 2.0: generate the initial balances (the preset arrays for 3/10/20/60 accounts, or a synthetic distribution, see --balance-dist) and populate the accounts
+        populateAccounts(bankAccounts, options.balances, NUM_ACCOUNTS);
+
+        // Step 2.1: sum the initial balances
+        Balance initialBalanceSum = single_balance(bankAccounts);
+        // Check if the sum is correct
+        if (initialBalanceSum != toBalance<Balance>(options.balances.total))
+        {
+            std::ostringstream message;
+            message << "Initial balance is inconsistent!  " << toDollars(initialBalanceSum);
+            reportError(message.str());
+        }
+    }
+
+    // Print the current configuration
+    text << "Running with ENGINE = " << info.name
+         << ", NUM_ACCOUNTS = " << NUM_ACCOUNTS
+         << ", NUM_THREADS = " << NUM_THREADS
+         << ", NUM_ITERATIONS = " << NUM_ITERATIONS
+         << ", STORE = " << storeLayoutName(options.store)
+         << ", BALANCE = " << balanceTypeName(options.balanceType)
+         << ", BALANCES = " << balanceDistributionName(options.balances.distribution);
+    if (info.usesLockStripes)
+    {
+        text << ", LOCK_STRIPES = " << options.lockStripes;
+    }
+    if (options.batchSize > 1)
+    {
+        text << ", BATCH = " << options.batchSize;
+    }
+    if (options.auditThreads > 0)
+    {
+        text << ", AUDIT_THREADS = " << options.auditThreads;
+    }
+    text << std::endl;
+
+    // Step 2.2: with --wal, replay the transfers the log holds over the initial balances (or those after the --restore checkpoint)
+    std::unique_ptr<WriteAheadLog<Balance>> wal;
+    if (!options.walFile.empty())
+    {
+        if (!ReportsDeposits<Engine, Balance>::value)
+        {
+            std::cerr << "Error: engine '" << info.name << "' does not report which transfers it applied, it cannot run with --wal" << std::endl;
+            return 1;
+        }
+        wal.reset(new WriteAheadLog<Balance>());
+        auto start = std::chrono::steady_clock::now();
+        if (!wal->open(options.walFile, options.balances, NUM_ACCOUNTS, bankAccounts, restore.lsn(), options.walGroup,
+                       std::chrono::microseconds(options.walWaitUs), options.walSync))
+        {
+            return 1;
+        }
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        text << "WAL: " << options.walFile << ", replayed " << wal->replayedRecords() << " transfers in " << elapsed.count() << " ms";
+        if (wal->cutBytes() > 0)
+        {
+            text << " (cut off a torn group of " << wal->cutBytes() << " bytes)";
+        }
+        text << ", SYNC = " << walSyncName(options.walSync) << ", GROUP = " << options.walGroup << ", WAIT_US = " << options.walWaitUs << std::endl;
+    }
+
+    // Step 5: the operations every thread performs (generated, see --mix, --amount, --senders, --receivers, or replayed from --trace)
+    TraceFile trace;
+    if (!options.traceFile.empty() && !trace.open(options.traceFile, NUM_ACCOUNTS))
+    {
+        return 1;
+    }
+    OperationSource<Balance> source(options.workload, NUM_ACCOUNTS, trace, options.traceMode);
+    result.workload = source.describe();
+    text << "Workload: " << result.workload << std::endl;
+    result.topology = placement.topologyName();
+    result.affinity = placement.affinityName();
+    result.numa = placement.numaName();
+    text << "Placement: TOPOLOGY = " << result.topology << ", AFFINITY = " << result.affinity << ", NUMA = " << result.numa << std::endl;
+
+    // Step 6: Multi-threading
+    Engine engine(bankAccounts, options);
+    std::unique_ptr<Checkpointer<Accounts>> checkpointer;
+    if (!options.checkpointFile.empty())
+    {
+        if (!SnapshotsAccounts<Engine>::value)
+        {
+            std::cerr << "Error: engine '" << info.name << "' keeps balances outside the accounts while it runs, it cannot write a --checkpoint" << std::endl;
+            return 1;
+        }
+        checkpointer.reset(new Checkpointer<Accounts>(bankAccounts, options.checkpointFile, options.balances, NUM_ACCOUNTS, NUM_THREADS, wal.get()));
+    }
+    std::vector<std::chrono::steady_clock::time_point> firstDeposits(NUM_THREADS, std::chrono::steady_clock::time_point::max());
+    // with --latency every worker fills its own histograms, merged after the join
+    std::vector<WorkerLatencies> workerLatencies(options.latency ? NUM_THREADS : 0);
+    result.measuredLatency = options.latency;
+    result.timerOverhead = options.latency ? measureTimerOverhead() : 0;
+    std::vector<char> pinned(NUM_THREADS, 0); // set by each worker once it runs on its --affinity CPU
+    std::vector<std::thread> threads;
+    std::vector<std::promise<float>> promises(NUM_THREADS); // promises to store exec_time_i, execution time
+    std::vector<std::future<float>> futures;                // futures to retrieve exec_time_i
+    // link the promises to futures
+    for (auto &promise : promises)
+    {
+        futures.push_back(promise.get_future());
+    }
+    // spawn the threads from our main thread
+    for (int t = 0; t < NUM_THREADS; ++t)
+    {
+        threads.emplace_back([&, t]()
+                             {
+                                 pinned[t] = placement.pinWorker(t);
+                                 // measure our do_work time
+                                 float exec_time = do_work(engine, source, t, NUM_ITERATIONS, NUM_THREADS, options.batchSize, wal.get(), checkpointer.get(),
+                                                           options.latency ? &workerLatencies[t] : nullptr, result.timerOverhead, firstDeposits[t]);
+                                 promises[t].set_value(exec_time); // store time in promise
+                             });
+    }
+    // join all threads
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    // keep the slowest thread's execution time
+    for (auto &future : futures)
+    {
+        float exec_time_i = future.get();
+        if (exec_time_i > result.maxExecutionTime)
+        {
+            result.maxExecutionTime = exec_time_i; // update the max execution time
+        }
+    }
+    for (int t = 0; t < NUM_THREADS; ++t)
+    {
+        if (!pinned[t])
+        {
+            reportError("could not pin worker " + std::to_string(t) + " to cpu " + std::to_string(placement.workerCpu(t)));
+        }
+    }
+    for (const auto &latencies : workerLatencies)
+    {
+        for (int type = 0; type < NUM_OP_TYPES; ++type)
+        {
+            result.latencies[type].merge(latencies[type]);
+        }
+    }
+    EngineReport engineReport;
+    engine.report(engineReport);
+    result.report.counters = engineReport.counters;
+    auto firstDeposit = *std::min_element(firstDeposits.begin(), firstDeposits.end());
+    if (firstDeposit != std::chrono::steady_clock::time_point::max())
+    {
+        // from the start of the process: parsing, the accounts (or the --restore), the engine, the workers' operations
+        result.report.counters.emplace_back("first_transfer_ms", std::chrono::duration<double, std::milli>(firstDeposit - PROGRAM_START).count());
+    }
+    result.report.locks = engineReport.locks;
+    if (options.profileLocks)
+    {
+        LockStats total;
+        for (const auto &lock : engineReport.locks)
+        {
+            total.acquisitions += lock.stats.acquisitions;
+            total.contended += lock.stats.contended;
+            total.waitNs += lock.stats.waitNs;
+            total.holdNs += lock.stats.holdNs;
+        }
+        result.report.counters.emplace_back("lock_acquisitions", static_cast<double>(total.acquisitions));
+        result.report.counters.emplace_back("lock_contended", static_cast<double>(total.contended));
+        result.report.counters.emplace_back("lock_wait_ms", total.waitNs / 1e6);
+        result.report.counters.emplace_back("lock_hold_ms", total.holdNs / 1e6);
+    }
+    for (const auto &error : engineReport.errors)
+    {
+        reportError(error);
+    }
+    if (wal)
+    {
+        wal->close();
+        result.report.counters.emplace_back("wal_replayed", static_cast<double>(wal->replayedRecords()));
+        result.report.counters.emplace_back("wal_records", static_cast<double>(wal->records()));
+        result.report.counters.emplace_back("wal_groups", static_cast<double>(wal->groups()));
+        result.report.counters.emplace_back("wal_records_per_group", wal->groups() == 0 ? 0.0 : static_cast<double>(wal->records()) / wal->groups());
+        result.report.counters.emplace_back("wal_flush_ms", wal->syncNanoseconds() / 1e6);
+        result.report.counters.emplace_back("wal_max_flush_us", wal->maxSyncNanoseconds() / 1e3);
+        if (!wal->error().empty())
+        {
+            reportError(wal->error());
+        }
+    }
+    if (checkpointer)
+    {
+        checkpointer->wait();
+        result.report.counters.emplace_back("checkpoint_lsn", static_cast<double>(checkpointer->lsn()));
+        result.report.counters.emplace_back("checkpoint_pause_ms", checkpointer->pauseNanoseconds() / 1e6);
+        result.report.counters.emplace_back("checkpoint_write_ms", checkpointer->writeNanoseconds() / 1e6);
+        if (!checkpointer->error().empty())
+        {
+            reportError(checkpointer->error());
+        }
+    }
+
+    // verify final balance (all workers have joined, so a plain sum is exact)
+    Balance finalBalance = single_balance(bankAccounts);
+    if (finalBalance != toBalance<Balance>(options.balances.total))
+    {
+        std::ostringstream message;
+        message << "Final balance is inconsistent!  " << toDollars(finalBalance);
+        reportError(message.str());
+    }
+
+    // Step 7: Single-threaded execution (the unsynchronized single_deposit/single_balance on the same accounts)
+    result.singleExecutionTime = single_do_work(bankAccounts, source, NUM_ITERATIONS);
+    printResult(options, info, result);
+    return 0;
+}
+
+// Instantiates runBank for the chosen balance type, account store and lock profiling, with
+// the accounts and the engine allocated under the --numa memory policy
+template <template <typename, typename> class Engine, template <typename> class Account>
+int runEngine(const BankOptions &options);
+
+// Every engine bank_bench can run. To add one, write an engine_*.h following the interface
+// described in engine.h and list it here.
+const std::vector<EngineInfo> ENGINES = {
+    {"none", "no synchronization (the baseline, inconsistent under contention)", false, &runEngine<NoLocksEngine, PlainAccount>},
+    {"coarse", "one mutex for the whole bank", false, &runEngine<CoarseLocksEngine, PlainAccount>},
+    {"combining", "flat combining: one lock holder applies every worker's published requests", false, &runEngine<CombiningEngine, PlainAccount>},
+    {"fine", "striped per-account locks taken with std::lock", true, &runEngine<FineLocksEngine, PlainAccount>},
+    {"unique", "striped per-account locks held by an RAII pair lock", true, &runEngine<UniqueLocksEngine, PlainAccount>},
+    {"fast", "phase gate: batched audit and transfer phases over striped locks", true, &runEngine<FastLocksEngine, PlainAccount>},
+    {"lockfree", "atomic accounts, optimistic balance() over per-worker in-flight slots", false, &runEngine<LockFreeEngine, AtomicAccount>},
+    {"seqlock", "per-account sequence locks, balance() never blocks deposits", false, &runEngine<SeqlockEngine, AtomicAccount>},
+    {"escrow", "per-worker escrowed slices of the balances, most withdrawals commit locally", false, &runEngine<EscrowEngine, AtomicAccount>},
+    {"subtotal", "transfers keep subtotals in a shallow tree, balance() adds the top level only", true, &runEngine<SubtotalEngine, AtomicAccount>},
+    {"mvcc", "versioned balances, balance() sums a point-in-time snapshot without blocking or retrying", true, &runEngine<MvccEngine, PlainAccount>},
+    {"delegation", "shard-owned accounts, cross-shard transfers delegated over SPSC rings", false, &runEngine<DelegationEngine, AtomicAccount>},
+};
+
+template <template <typename, typename> class Engine, template <typename> class Account>
+int runEngine(const BankOptions &options)
+{
+    const EngineInfo *info = nullptr;
+    for (const auto &engine : ENGINES)
+    {
+        if (engine.name == options.engine)
+        {
+            info = &engine;
+        }
+    }
+    Placement placement;
+    if (!placement.plan(options.affinity, options.numa, options.numThreads) || !placement.applyMemoryPolicy())
+    {
+        return 1;
+    }
+    return withBalanceType(options.balanceType, [&](auto zero)
+                           {
+                               using Balance = decltype(zero);
+                               // with --restore a packed store serves the accounts from the checkpoint's mapping
+                               CheckpointFile<Balance> restore;
+                               if (!options.restoreFile.empty() && !restore.open(options.restoreFile, options.balances, options.numAccounts))
+                               {
+                                   return 1;
+                               }
+                               AccountMapping cells = options.store == StoreLayout::Packed ? restore.takeBalances() : AccountMapping();
+                               return withAccountStore<Account<Balance>>(options.store, options.numAccounts, std::move(cells), [&](auto &bankAccounts)
+                                                                         {
+                                                                             using Accounts = std::remove_reference_t<decltype(bankAccounts)>;
+                                                                             if (options.profileLocks)
+                                                                                 return runBank<Engine<Accounts, ProfiledLocks>>(bankAccounts, options, *info, placement, restore);
+                                                                             return runBank<Engine<Accounts, PlainLocks>>(bankAccounts, options, *info, placement, restore);
+                                                                         });
+                           });
+}
+
+void printEngines()
+{
+    std::size_t width = 0; // the longest name, then one space before the descriptions
+    for (const auto &engine : ENGINES)
+    {
+        width = std::max(width, std::string(engine.name).size());
+    }
+    std::cerr << "Engines:\n";
+    for (const auto &engine : ENGINES)
+    {
+        std::cerr << "  " << engine.name << std::string(width + 1 - std::string(engine.name).size(), ' ') << engine.description << "\n";
+    }
+    std::cerr << std::flush;
+}
+
+int main(int argc, char *argv[])
+{
+    // Step 1: Parse the command-line arguments to set NUM_ACCOUNTS, NUM_THREADS, NUM_ITERATIONS, the engine, the account store and the balance type
+    BankOptions options;
+    if (!parseBankOptions(argc, argv, options))
+    {
+        printEngines();
+        return 1;
+    }
+
+    for (const auto &engine : ENGINES)
+    {
+        if (engine.name == options.engine)
+        {
+            return engine.run(options);
+        }
+    }
+    std::cerr << "Error: " << (options.engine.empty() ? "no engine given (--engine=NAME)" : "unknown engine '" + options.engine + "'") << std::endl;
+    printEngines();
+    return 1;
+}
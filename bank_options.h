@@ -0,0 +1,347 @@
+#ifndef BANK_OPTIONS_H
+#define BANK_OPTIONS_H
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "account_store.h"
+#include "balance_generator.h"
+#include "balance_types.h"
+#include "lock_table.h"
+#include "placement.h"
+#include "trace.h"
+#include "wal.h"
+#include "workload.h"
+
+// How bank_bench prints its results
+enum class OutputFormat
+{
+    Text, // the human-readable report
+    Csv,  // a header line and one row per run
+    Json  // one object per run
+};
+
+inline bool parseOutputFormat(const std::string &name, OutputFormat &format)
+{
+    if (name == "text")
+        format = OutputFormat::Text;
+    else if (name == "csv")
+        format = OutputFormat::Csv;
+    else if (name == "json")
+        format = OutputFormat::Json;
+    else
+        return false;
+    return true;
+}
+
+// Command-line configuration of bank_bench (and bank_trace record):
+//   <num_accounts> <num_threads> <num_iterations> [--option=value ...]
+struct BankOptions
+{
+    std::string engine;                       // --engine=NAME, see the registry in bank_bench.cpp
+    OutputFormat output = OutputFormat::Text; // --output=text|csv|json
+    bool latency = false;                     // --latency: per-operation latency histograms
+    bool profileLocks = false;                // --profile-locks: lock contention counters and heatmap
+    AffinitySpec affinity;                    // --affinity=none|compact|scatter|CPU,...: where the workers run
+    NumaPolicy numa = NumaPolicy::None;       // --numa=none|local|interleave: where the shared memory lives
+    int batchSize = 1;                        // --batch=N: consecutive deposits handed to deposit_batch() at once
+    int auditThreads = 0;                     // --audit-threads=N: helper threads splitting every balance() scan
+    int verifyInterval = 0;                   // --verify=N: engines keeping subtotals check them every N balance() calls
+    std::string walFile;                      // --wal=FILE: log every applied transfer, replayed at startup
+    int walGroup = 0;                         // --wal-group=N: records flushed together at most (0: one per worker)
+    int walWaitUs = 100;                      // --wal-wait-us=N: how long a group waits to fill before its flush
+    WalSync walSync = WalSync::Fdatasync;     // --wal-sync=fdatasync|fsync|none
+    std::string checkpointFile;               // --checkpoint=FILE: write a checkpoint halfway through the run
+    std::string restoreFile;                  // --restore=FILE: start from a checkpoint instead of the generated balances
+    int numAccounts = 0;
+    int numThreads = 0;
+    int numIterations = 0;
+    StoreLayout store = StoreLayout::Packed;
+    BalanceType balanceType = BalanceType::Cents;
+    std::size_t lockStripes = 0; // 0 until parsed: then --lock-stripes or defaultLockStripes()
+    BalanceSpec balances;        // initial balances (--balance-dist, --balance-shape, --total, --seed)
+    WorkloadSpec workload;       // operations run by do_work() (--mix, --range-size, --amount, --senders, --receivers, --seed)
+    std::string traceFile;       // replay this trace instead of generating the operations (--trace)
+    TraceMode traceMode = TraceMode::Partition;
+};
+
+inline void printBankUsage(const char *program)
+{
+    std::cerr << "Usage: " << program << " <num_accounts> <num_threads> <num_iterations> [options]\n"
+              << "  --engine=NAME               synchronization engine to benchmark (required)\n"
+              << "  --output=text|csv|json      result format (default: text)\n"
+              << "  --latency                   time every operation and report p50/p99/p99.9/max per operation type\n"
+              << "  --profile-locks             count acquisitions, contention, wait and hold time of every lock\n"
+              << "                              and print a per-account contention heatmap\n"
+              << "  --affinity=none|compact|scatter|CPUS\n"
+              << "                              pin the workers: fill cores and sockets in order, spread over sockets,\n"
+              << "                              or the listed CPUs, e.g. 0,2,4-7 (default: none)\n"
+              << "  --numa=none|local|interleave\n"
+              << "                              place the accounts, lock tables and engine state on the node running\n"
+              << "                              most workers, or interleave them over the workers' nodes (default: none)\n"
+              << "  --batch=N                   hand up to N consecutive deposits to the engine's deposit_batch()\n"
+              << "                              (default: 1, every deposit on its own)\n"
+              << "  --audit-threads=N           split every balance() scan over N helper threads plus the auditing\n"
+              << "                              worker, for engines that scan the accounts (default: 0, no helpers)\n"
+              << "  --verify=N                  engines keeping subtotals (subtotal) check them against a full scan\n"
+              << "                              every N balance() calls of a worker (default: 0, never; cents only)\n"
+              << "  --wal=FILE                  write-ahead log: replay FILE over the initial balances, then make every\n"
+              << "                              applied transfer durable in it before deposit() returns (cents only)\n"
+              << "  --wal-group=N               flush a group once N transfers wait for it (default: 0, one per worker)\n"
+              << "  --wal-wait-us=N             or once its first transfer has waited N microseconds (default: 100)\n"
+              << "  --wal-sync=fdatasync|fsync|none\n"
+              << "                              how a flush makes its group durable (default: fdatasync)\n"
+              << "  --checkpoint=FILE           write a checkpoint of the accounts to FILE halfway through worker 0's\n"
+              << "                              operations, while the other workers go on\n"
+              << "  --restore=FILE              start from the checkpoint FILE (then the --wal records after it)\n"
+              << "                              instead of the generated balances\n"
+              << "  --store=map|packed|padded   account storage layout (default: packed)\n"
+              << "  --balance=float|cents       balance representation (default: cents)\n"
+              << "  --lock-stripes=N            per-account lock table size, rounded up to a power of two\n"
+              << "                              (1 to " << MAX_LOCK_STRIPES << "; default: one per account, at most " << MAX_DEFAULT_LOCK_STRIPES << ")\n"
+              << "  --balance-dist=preset|uniform|lognormal|pareto\n"
+              << "                              initial balances (default: preset, the built-in arrays for 3/10/20/60\n"
+              << "                              accounts and uniform for any other number)\n"
+              << "  --balance-shape=X           lognormal sigma (default 1.0) or Pareto alpha (default 1.16)\n"
+              << "  --total=DOLLARS             sum of the initial balances (default: 100000)\n"
+              << "  --seed=N                    seed for the generated balances and operations (default: 375)\n"
+              << "  --mix=DEPOSIT/BALANCE[/GET[/RANGE]]\n"
+              << "                              relative weights of deposit(), balance(), get_balance() and\n"
+              << "                              range_balance() (default: 95/5, no single-account or range reads)\n"
+              << "  --range-size=N              accounts read by every range_balance() (default: 16)\n"
+              << "  --amount=fixed:D|uniform:MIN:MAX|lognormal:MEDIAN:SIGMA\n"
+              << "                              transfer amount in dollars (default: fixed:5000)\n"
+              << "  --senders=uniform|zipf[:THETA]|hotspot[:FRACTION[:PROBABILITY]]\n"
+              << "                              which accounts send money (default: uniform; zipf theta 0.99,\n"
+              << "                              hotspot 1% of the accounts getting 90% of the picks)\n"
+              << "  --receivers=...             which accounts receive money, same syntax (default: uniform)\n"
+              << "  --skew=...                  shorthand for the same --senders and --receivers\n"
+              << "  --trace=FILE                replay a binary trace (see bank_trace) instead of generating operations\n"
+              << "  --trace-mode=partition|shared\n"
+              << "                              every worker replays its own slice of the trace, or all workers pull\n"
+              << "                              from a shared cursor (default: partition)" << std::endl;
+}
+
+inline bool parseBankOptions(int argc, char *argv[], BankOptions &options)
+{
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg.rfind("--", 0) != 0)
+        {
+            positional.push_back(arg);
+            continue;
+        }
+
+        std::string::size_type eq = arg.find('=');
+        std::string name = arg.substr(2, eq == std::string::npos ? std::string::npos : eq - 2);
+        std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+
+        bool ok = false;
+        try
+        {
+            if (name == "engine")
+            {
+                options.engine = value;
+                ok = !value.empty();
+            }
+            else if (name == "latency")
+            {
+                options.latency = true;
+                ok = eq == std::string::npos;
+            }
+            else if (name == "profile-locks")
+            {
+                options.profileLocks = true;
+                ok = eq == std::string::npos;
+            }
+            else if (name == "batch")
+            {
+                options.batchSize = std::stoi(value);
+                ok = options.batchSize >= 1;
+            }
+            else if (name == "audit-threads")
+            {
+                options.auditThreads = std::stoi(value);
+                ok = options.auditThreads >= 0;
+            }
+            else if (name == "verify")
+            {
+                options.verifyInterval = std::stoi(value);
+                ok = options.verifyInterval >= 0;
+            }
+            else if (name == "wal")
+            {
+                options.walFile = value;
+                ok = !value.empty();
+            }
+            else if (name == "wal-group")
+            {
+                options.walGroup = std::stoi(value);
+                ok = options.walGroup >= 0;
+            }
+            else if (name == "wal-wait-us")
+            {
+                options.walWaitUs = std::stoi(value);
+                ok = options.walWaitUs >= 0;
+            }
+            else if (name == "wal-sync")
+            {
+                ok = parseWalSync(value, options.walSync);
+            }
+            else if (name == "checkpoint")
+            {
+                options.checkpointFile = value;
+                ok = !value.empty();
+            }
+            else if (name == "restore")
+            {
+                options.restoreFile = value;
+                ok = !value.empty();
+            }
+            else if (name == "affinity")
+            {
+                ok = parseAffinitySpec(value, options.affinity);
+            }
+            else if (name == "numa")
+            {
+                ok = parseNumaPolicy(value, options.numa);
+            }
+            else if (name == "output")
+            {
+                ok = parseOutputFormat(value, options.output);
+            }
+            else if (name == "store")
+            {
+                ok = parseStoreLayout(value, options.store);
+            }
+            else if (name == "balance")
+            {
+                ok = parseBalanceType(value, options.balanceType);
+            }
+            else if (name == "lock-stripes")
+            {
+                long long stripes = std::stoll(value);
+                ok = stripes >= 1 && static_cast<unsigned long long>(stripes) <= MAX_LOCK_STRIPES;
+                options.lockStripes = ok ? roundUpToPowerOfTwo(static_cast<std::size_t>(stripes)) : 0;
+            }
+            else if (name == "balance-dist")
+            {
+                ok = parseBalanceDistribution(value, options.balances.distribution);
+            }
+            else if (name == "balance-shape")
+            {
+                options.balances.shape = std::stod(value);
+                ok = options.balances.shape > 0;
+            }
+            else if (name == "total")
+            {
+                options.balances.total = std::stod(value);
+                ok = options.balances.total >= 0;
+            }
+            else if (name == "seed")
+            {
+                ok = !value.empty() && value.find_first_not_of("0123456789") == std::string::npos; // std::stoull would wrap a negative seed
+                options.balances.seed = ok ? std::stoull(value) : 0;
+                options.workload.seed = options.balances.seed;
+            }
+            else if (name == "mix")
+            {
+                ok = parseMixSpec(value, options.workload);
+            }
+            else if (name == "range-size")
+            {
+                options.workload.rangeSize = std::stoi(value);
+                ok = options.workload.rangeSize >= 1;
+            }
+            else if (name == "amount")
+            {
+                ok = parseAmountSpec(value, options.workload.amount);
+            }
+            else if (name == "senders")
+            {
+                ok = parseSkewSpec(value, options.workload.senders);
+            }
+            else if (name == "receivers")
+            {
+                ok = parseSkewSpec(value, options.workload.receivers);
+            }
+            else if (name == "skew")
+            {
+                ok = parseSkewSpec(value, options.workload.senders) && parseSkewSpec(value, options.workload.receivers);
+            }
+            else if (name == "trace")
+            {
+                options.traceFile = value;
+                ok = !value.empty();
+            }
+            else if (name == "trace-mode")
+            {
+                ok = parseTraceMode(value, options.traceMode);
+            }
+        }
+        catch (const std::exception &)
+        {
+            ok = false; // not a number, or out of range
+        }
+        if (!ok)
+        {
+            std::cerr << "Error: invalid option '" << arg << "'" << std::endl;
+            printBankUsage(argv[0]);
+            return false;
+        }
+    }
+
+    if (positional.size() != 3)
+    {
+        printBankUsage(argv[0]);
+        return false;
+    }
+
+    try
+    {
+        options.numAccounts = std::stoi(positional[0]);
+        options.numThreads = std::stoi(positional[1]);
+        options.numIterations = std::stoi(positional[2]);
+    }
+    catch (const std::exception &)
+    {
+        std::cerr << "Error: invalid number in '" << positional[0] << " " << positional[1] << " " << positional[2] << "'" << std::endl;
+        printBankUsage(argv[0]);
+        return false;
+    }
+    if (options.numAccounts < 2 || options.numThreads < 1 || options.numIterations < 0)
+    {
+        std::cerr << "Error: need at least 2 accounts and 1 thread" << std::endl;
+        return false;
+    }
+    if (!options.walFile.empty() && options.batchSize > 1)
+    {
+        std::cerr << "Error: --wal cannot be combined with --batch (deposit_batch() does not tell which transfers it applied)" << std::endl;
+        return false;
+    }
+    if (!options.walFile.empty() && options.balanceType != BalanceType::Cents)
+    {
+        std::cerr << "Error: --wal needs --balance=cents (float transfers replayed in log order round differently)" << std::endl;
+        return false;
+    }
+    if (options.verifyInterval > 0 && options.balanceType != BalanceType::Cents)
+    {
+        std::cerr << "Error: --verify needs --balance=cents (float subtotals drift from a fresh scan by rounding alone)" << std::endl;
+        return false;
+    }
+    if (options.walGroup == 0)
+    {
+        options.walGroup = options.numThreads;
+    }
+    if (options.lockStripes == 0)
+    {
+        options.lockStripes = defaultLockStripes(options.numAccounts);
+    }
+    return true;
+}
+
+#endif
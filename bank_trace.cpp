@@ -0,0 +1,205 @@
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "balance_types.h"
+#include "bank_options.h"
+#include "trace.h"
+#include "workload.h"
+
+// Writes, converts and inspects the binary traces replayed with --trace=FILE:
+//   bank_trace record FILE <num_accounts> <num_threads> <num_iterations> [workload options]
+//   bank_trace convert LEDGER.csv FILE
+//   bank_trace info FILE
+
+void printTraceUsage(const char *program)
+{
+    std::cerr << "Usage: " << program << " record FILE <num_accounts> <num_threads> <num_iterations> [options]\n"
+              << "         writes the operations bank_bench would generate with the same arguments\n"
+              << "         (--mix, --range-size, --amount, --senders, --receivers, --skew, --seed), one slice per thread,\n"
+              << "         so replaying it with --trace-mode=partition reproduces that run\n"
+              << "       " << program << " convert LEDGER.csv FILE\n"
+              << "         converts a ledger with one operation per line: deposit,FROM,TO,DOLLARS (FROM and TO differ),\n"
+              << "         balance, get,ACCOUNT or range,FIRST,LAST\n"
+              << "         (blank lines and lines starting with '#' are skipped)\n"
+              << "       " << program << " info FILE" << std::endl;
+}
+
+int recordTrace(const std::string &path, int argc, char *argv[])
+{
+    BankOptions options;
+    if (!parseBankOptions(argc, argv, options))
+    {
+        return 1;
+    }
+
+    TraceWriter writer;
+    if (!writer.open(path))
+    {
+        std::cerr << "Error: cannot write trace '" << path << "'" << std::endl;
+        return 1;
+    }
+    // the same streams do_work() generates: stream t holds worker t's operations
+    Workload workload(options.workload, options.numAccounts);
+    for (int t = 0; t < options.numThreads; ++t)
+    {
+        OperationGenerator<Cents> generator(workload, t);
+        for (int i = 0; i < options.numIterations / options.numThreads; ++i)
+        {
+            Operation<Cents> op = generator.next();
+            writer.append(op.type, op.from, op.to, op.amount);
+        }
+    }
+    if (!writer.close())
+    {
+        std::cerr << "Error: cannot write trace '" << path << "'" << std::endl;
+        return 1;
+    }
+    std::cout << "Wrote " << writer.size() << " operations to " << path << std::endl;
+    return 0;
+}
+
+int convertLedger(const std::string &ledgerPath, const std::string &path)
+{
+    std::ifstream ledger(ledgerPath);
+    if (!ledger)
+    {
+        std::cerr << "Error: cannot open ledger '" << ledgerPath << "'" << std::endl;
+        return 1;
+    }
+    TraceWriter writer;
+    if (!writer.open(path))
+    {
+        std::cerr << "Error: cannot write trace '" << path << "'" << std::endl;
+        return 1;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(ledger, line))
+    {
+        ++lineNumber;
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+
+        std::vector<std::string> fields = splitWorkloadArg(line, ',');
+        bool ok = false;
+        if (fields.size() == 1 && fields[0] == "balance")
+        {
+            writer.append(OpType::Balance, 0, 0, 0);
+            ok = true;
+        }
+        else if ((fields.size() == 2 && fields[0] == "get") || (fields.size() == 3 && fields[0] == "range"))
+        {
+            try
+            {
+                int first = std::stoi(fields[1]);
+                int last = fields.size() == 3 ? std::stoi(fields[2]) : first;
+                ok = first >= 1 && first <= last;
+                if (ok)
+                {
+                    writer.append(fields.size() == 3 ? OpType::RangeBalance : OpType::GetBalance, first, last, 0);
+                }
+            }
+            catch (const std::exception &)
+            {
+                ok = false;
+            }
+        }
+        else if (fields.size() == 4 && fields[0] == "deposit")
+        {
+            try
+            {
+                int from = std::stoi(fields[1]);
+                int to = std::stoi(fields[2]);
+                Cents amount = toBalance<Cents>(std::stod(fields[3]));
+                ok = from >= 1 && to >= 1 && from != to && amount >= 0;
+                if (ok)
+                {
+                    writer.append(OpType::Deposit, from, to, amount);
+                }
+            }
+            catch (const std::exception &)
+            {
+                ok = false;
+            }
+        }
+        if (!ok)
+        {
+            std::cerr << "Error: " << ledgerPath << ":" << lineNumber << ": expected deposit,FROM,TO,DOLLARS (FROM and TO differ), balance, get,ACCOUNT or range,FIRST,LAST" << std::endl;
+            return 1;
+        }
+    }
+    if (!writer.close())
+    {
+        std::cerr << "Error: cannot write trace '" << path << "'" << std::endl;
+        return 1;
+    }
+    std::cout << "Wrote " << writer.size() << " operations to " << path << std::endl;
+    return 0;
+}
+
+int printTraceInfo(const std::string &path)
+{
+    TraceFile trace;
+    if (!trace.open(path))
+    {
+        return 1;
+    }
+    std::size_t counts[NUM_OP_TYPES] = {};
+    Cents volume = 0;
+    for (std::size_t i = 0; i < trace.size(); ++i)
+    {
+        const TraceRecord &record = trace.records()[i];
+        ++counts[static_cast<int>(record.type)];
+        if (record.type == OpType::Deposit)
+        {
+            volume += record.amount;
+        }
+    }
+    std::cout << "Trace " << path << ": " << trace.size() << " operations (" << counts[static_cast<int>(OpType::Deposit)] << " deposits, "
+              << counts[static_cast<int>(OpType::Balance)] << " balances";
+    if (counts[static_cast<int>(OpType::GetBalance)] + counts[static_cast<int>(OpType::RangeBalance)] > 0)
+    {
+        std::cout << ", " << counts[static_cast<int>(OpType::GetBalance)] << " single-account reads, "
+                  << counts[static_cast<int>(OpType::RangeBalance)] << " range reads";
+    }
+    std::cout << "), accounts 1.." << trace.numAccounts()
+              << ", deposit volume " << toDollars(volume) << " dollars" << std::endl;
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        printTraceUsage(argv[0]);
+        return 1;
+    }
+    std::string command = argv[1];
+    if (command == "record")
+    {
+        // parse the rest like the bank_bench command line
+        std::vector<char *> args = {argv[0]};
+        args.insert(args.end(), argv + 3, argv + argc);
+        return recordTrace(argv[2], static_cast<int>(args.size()), args.data());
+    }
+    if (command == "convert" && argc == 4)
+    {
+        return convertLedger(argv[2], argv[3]);
+    }
+    if (command == "info" && argc == 3)
+    {
+        return printTraceInfo(argv[2]);
+    }
+    printTraceUsage(argv[0]);
+    return 1;
+}
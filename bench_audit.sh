@@ -0,0 +1,44 @@
+#!/bin/bash
+
+# Measures the parallel audit (--audit-threads) as the books grow: an audit-heavy mix on
+# 1M/10M/100M accounts with 0/1/3/7 helper threads per engine, printing bank_bench's CSV
+# (a header line, then one row per run). The speedup of a row is its audit_threads=0 row's
+# time divided by its own
+
+# Options are passed on to bank_bench (e.g. --balance=float or --store=padded)
+ENGINES="coarse seqlock escrow"
+NUM_THREADS=4
+NUM_ITERATIONS=2000
+
+# Load the correct GCC module
+module load gcc-11.2.0
+
+# Verify GCC version
+GCC_VERSION=$(gcc --version | head -n 1)
+if [[ ! "$GCC_VERSION" =~ "11.2.0" ]]; then
+  echo "Error: Failed to switch to GCC 11.2.0. Current version is: $GCC_VERSION"
+  exit 1
+fi
+echo "Using compiler: $GCC_VERSION"
+
+# Compile the benchmark with threading support and optimization
+if [[ ! -f bank_bench.cpp ]]; then
+  echo "Error: bank_bench.cpp not found!"
+  exit 1
+fi
+g++ -std=c++17 -pthread -O3 bank_bench.cpp -o bank_bench
+if [[ $? -ne 0 ]]; then
+  echo "Compilation of bank_bench.cpp failed!"
+  exit 1
+fi
+
+# Run every engine with different account counts and helper counts (errors go to stderr), keeping one CSV header
+HEADER=1
+for NUM_ACCOUNTS in 1000000 10000000 100000000; do
+  for ENGINE in $ENGINES; do
+    for AUDIT_THREADS in 0 1 3 7; do
+      ./bank_bench "$NUM_ACCOUNTS" "$NUM_THREADS" "$NUM_ITERATIONS" --engine="$ENGINE" --mix=50/50 --audit-threads="$AUDIT_THREADS" --output=csv "$@" | tail -n +$((2 - HEADER))
+      HEADER=0
+    done
+  done
+done
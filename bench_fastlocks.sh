@@ -0,0 +1,45 @@
+#!/bin/bash
+
+# Compares the phase-gate engine (fast) with the fine- and coarse-grained engines at
+# 2/4/8/16 threads and prints bank_bench's CSV: a header line, then one row per run
+
+# Check if the correct number of arguments is passed (script expects the number of accounts, optionally followed by program options)
+if [[ $# -lt 1 ]]; then
+  echo "Usage: $0 <num_accounts> [options]"
+  exit 1
+fi
+
+NUM_ACCOUNTS=$1
+NUM_ITERATIONS=1000000
+ENGINES="fast coarse fine"
+
+# Load the correct GCC module
+module load gcc-11.2.0
+
+# Verify GCC version
+GCC_VERSION=$(gcc --version | head -n 1)
+if [[ ! "$GCC_VERSION" =~ "11.2.0" ]]; then
+  echo "Error: Failed to switch to GCC 11.2.0. Current version is: $GCC_VERSION"
+  exit 1
+fi
+echo "Using compiler: $GCC_VERSION"
+
+# Compile the benchmark with threading support and optimization
+if [[ ! -f bank_bench.cpp ]]; then
+  echo "Error: bank_bench.cpp not found!"
+  exit 1
+fi
+g++ -std=c++17 -pthread -O3 bank_bench.cpp -o bank_bench
+if [[ $? -ne 0 ]]; then
+  echo "Compilation of bank_bench.cpp failed!"
+  exit 1
+fi
+
+# Run every engine with different NUM_THREADS values (errors go to stderr), keeping one CSV header
+HEADER=1
+for NUM_THREADS in 2 4 8 16; do
+  for ENGINE in $ENGINES; do
+    ./bank_bench "$NUM_ACCOUNTS" "$NUM_THREADS" "$NUM_ITERATIONS" --engine="$ENGINE" --output=csv "${@:2}" | tail -n +$((2 - HEADER))
+    HEADER=0
+  done
+done
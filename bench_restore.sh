@@ -0,0 +1,63 @@
+#!/bin/bash
+
+# Measures the time to the first transfer (first_transfer_ms, from the start of the process)
+# on 1M/10M/100M accounts: generating the balances, then restoring them from a checkpoint
+# (--restore). The checkpoint is written first by a short run with --checkpoint. Prints
+# bank_bench's CSV (a header line, then one row per run; the restored column tells them apart)
+
+# Options are passed on to bank_bench (e.g. --store=padded or --engine=lockfree).
+# CHECKPOINT_DIR puts the checkpoint on the disk to measure (default: the current directory);
+# it is read from the page cache unless the cache is dropped between the runs
+ENGINE=coarse
+NUM_THREADS=4
+NUM_ITERATIONS=1000
+CHECKPOINT_FILE="${CHECKPOINT_DIR:-.}/bench_restore.ckpt"
+WAL_FILE="${CHECKPOINT_DIR:-.}/bench_restore.wal"
+
+# Load the correct GCC module
+module load gcc-11.2.0
+
+# Verify GCC version
+GCC_VERSION=$(gcc --version | head -n 1)
+if [[ ! "$GCC_VERSION" =~ "11.2.0" ]]; then
+  echo "Error: Failed to switch to GCC 11.2.0. Current version is: $GCC_VERSION"
+  exit 1
+fi
+echo "Using compiler: $GCC_VERSION"
+
+# Compile the benchmark with threading support and optimization
+if [[ ! -f bank_bench.cpp ]]; then
+  echo "Error: bank_bench.cpp not found!"
+  exit 1
+fi
+g++ -std=c++17 -pthread -O3 bank_bench.cpp -o bank_bench
+if [[ $? -ne 0 ]]; then
+  echo "Compilation of bank_bench.cpp failed!"
+  exit 1
+fi
+
+# A checkpoint taken while the workers transfer has to land in the middle of the run: it must cover fewer
+# of the logged transfers than the run made (checkpoint_lsn < wal_records). Counters stay below 10^6, which
+# bank_bench prints without an exponent
+rm -f "$CHECKPOINT_FILE" "$WAL_FILE"
+COUNTERS=$(./bank_bench 100000 "$NUM_THREADS" 20000 --engine="$ENGINE" --mix=100/0 --total=100000000 --amount=uniform:1:100 \
+  --wal="$WAL_FILE" --wal-sync=none --checkpoint="$CHECKPOINT_FILE" --output=csv "$@" | tail -n 1)
+CHECKPOINT_LSN=$(grep -o 'checkpoint_lsn=[0-9]*' <<< "$COUNTERS" | cut -d= -f2)
+WAL_RECORDS=$(grep -o 'wal_records=[0-9]*' <<< "$COUNTERS" | cut -d= -f2)
+rm -f "$WAL_FILE"
+if [[ -z "$CHECKPOINT_LSN" || -z "$WAL_RECORDS" || "$CHECKPOINT_LSN" -ge "$WAL_RECORDS" ]]; then
+  echo "Error: the checkpoint taken by $NUM_THREADS workers covers ${CHECKPOINT_LSN:-?} of ${WAL_RECORDS:-?} transfers, not part of them" >&2
+  exit 1
+fi
+echo "Checkpoint taken by $NUM_THREADS workers covers $CHECKPOINT_LSN of $WAL_RECORDS transfers" >&2
+
+# Every operation is a transfer (--mix=100/0), so the first operation is the first transfer (errors go to stderr), keeping one CSV header
+HEADER=1
+for NUM_ACCOUNTS in 1000000 10000000 100000000; do
+  rm -f "$CHECKPOINT_FILE"
+  ./bank_bench "$NUM_ACCOUNTS" 1 2 --engine="$ENGINE" --mix=100/0 --checkpoint="$CHECKPOINT_FILE" --output=csv "$@" > /dev/null
+  ./bank_bench "$NUM_ACCOUNTS" "$NUM_THREADS" "$NUM_ITERATIONS" --engine="$ENGINE" --mix=100/0 --output=csv "$@" | tail -n +$((2 - HEADER))
+  HEADER=0
+  ./bank_bench "$NUM_ACCOUNTS" "$NUM_THREADS" "$NUM_ITERATIONS" --engine="$ENGINE" --mix=100/0 --restore="$CHECKPOINT_FILE" --output=csv "$@" | tail -n +2
+done
+rm -f "$CHECKPOINT_FILE"
@@ -0,0 +1,56 @@
+#!/bin/bash
+
+# Measures what durable transfers cost: every engine runs at 2/4/8/16 threads in memory and
+# with a write-ahead log (--wal, group commit with one fdatasync per group), printing
+# bank_bench's CSV (a header line, then one row per run; the wal column tells them apart).
+# The log is deleted before every run, so each one starts from the same books
+
+# Usage: ./bench_wal.sh <num_accounts> [options]
+# Options are passed on to bank_bench (e.g. --wal-wait-us=500 or --wal-sync=fsync).
+# WAL_DIR puts the log on the disk to measure (default: the current directory)
+ENGINES="coarse unique lockfree"
+NUM_ITERATIONS=20000
+WAL_FILE="${WAL_DIR:-.}/bench_wal.log"
+
+if [[ -z "$1" ]]; then
+  echo "Usage: $0 <num_accounts> [options]"
+  exit 1
+fi
+NUM_ACCOUNTS=$1
+shift
+# $1000 per account on average and transfers of $1..$100, so nearly every transfer is applied (and logged)
+BOOKS="--total=$((NUM_ACCOUNTS * 1000)) --amount=uniform:1:100"
+
+# Load the correct GCC module
+module load gcc-11.2.0
+
+# Verify GCC version
+GCC_VERSION=$(gcc --version | head -n 1)
+if [[ ! "$GCC_VERSION" =~ "11.2.0" ]]; then
+  echo "Error: Failed to switch to GCC 11.2.0. Current version is: $GCC_VERSION"
+  exit 1
+fi
+echo "Using compiler: $GCC_VERSION"
+
+# Compile the benchmark with threading support and optimization
+if [[ ! -f bank_bench.cpp ]]; then
+  echo "Error: bank_bench.cpp not found!"
+  exit 1
+fi
+g++ -std=c++17 -pthread -O3 bank_bench.cpp -o bank_bench
+if [[ $? -ne 0 ]]; then
+  echo "Compilation of bank_bench.cpp failed!"
+  exit 1
+fi
+
+# Run every engine with different thread counts, without and with the log (errors go to stderr), keeping one CSV header
+HEADER=1
+for ENGINE in $ENGINES; do
+  for NUM_THREADS in 2 4 8 16; do
+    ./bank_bench "$NUM_ACCOUNTS" "$NUM_THREADS" "$NUM_ITERATIONS" --engine="$ENGINE" $BOOKS --output=csv "$@" | tail -n +$((2 - HEADER))
+    HEADER=0
+    rm -f "$WAL_FILE"
+    ./bank_bench "$NUM_ACCOUNTS" "$NUM_THREADS" "$NUM_ITERATIONS" --engine="$ENGINE" $BOOKS --wal="$WAL_FILE" --output=csv "$@" | tail -n +2
+  done
+done
+rm -f "$WAL_FILE"
@@ -0,0 +1,360 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "account_store.h"
+#include "balance_generator.h"
+#include "balance_types.h"
+#include "wal.h"
+
+// Checkpoints of the accounts (--checkpoint=FILE, --restore=FILE): a CheckpointHeader on a
+// page of its own, then every balance from account 1 on as the packed store keeps it in
+// memory (float, or int64 cents). A restore maps the file copy-on-write and a packed store
+// serves its accounts straight from the mapping, so there is nothing to parse, allocate or
+// initialize per account, and only the pages the transfers touch are ever read. The other
+// stores copy the balances in.
+//
+// A checkpoint is taken between operations: the workers are held at a gate until none of
+// them is inside the engine, so bankAccounts holds every balance (and with --wal every
+// transfer below the current LSN, and none above). The process then forks: the child writes
+// its copy-on-write image of the accounts, which no later transfer changes, while the
+// workers go on as soon as the fork returns. The child writes FILE.tmp and renames it, so
+// FILE is always a complete checkpoint.
+
+constexpr char CHECKPOINT_MAGIC[8] = {'B', 'A', 'N', 'K', 'C', 'K', 'P', '1'};
+constexpr std::size_t CHECKPOINT_DATA_OFFSET = 4096;        // where the balances start, page aligned
+constexpr std::size_t CHECKPOINT_CHUNK_ACCOUNTS = 1 << 16; // balances the child writes at once
+
+struct CheckpointHeader
+{
+    char magic[8];
+    std::uint32_t balanceSize;  // 8 with cents, 4 with float
+    std::uint32_t distribution; // the books the balances came from, as in WalHeader
+    std::uint64_t numAccounts;
+    std::uint64_t seed;
+    double total;
+    double shape;
+    std::uint64_t lsn; // the checkpoint includes the --wal records below this LSN (0 without a log)
+};
+
+template <typename Balance>
+CheckpointHeader makeCheckpointHeader(const BalanceSpec &spec, int numAccounts, std::uint64_t lsn)
+{
+    CheckpointHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    header.balanceSize = sizeof(Balance);
+    header.distribution = static_cast<std::uint32_t>(spec.distribution);
+    header.numAccounts = static_cast<std::uint64_t>(numAccounts);
+    header.seed = spec.seed;
+    header.total = spec.total;
+    header.shape = spec.shape;
+    header.lsn = lsn;
+    return header;
+}
+
+// True unless Engine has a finish(): those engines (escrow, delegation) keep money outside
+// bankAccounts until their workers finish, even between operations
+template <typename Engine, typename = void>
+struct SnapshotsAccounts : std::true_type
+{
+};
+
+template <typename Engine>
+struct SnapshotsAccounts<Engine, decltype(std::declval<Engine &>().finish(0))> : std::false_type
+{
+};
+
+// A checkpoint to restore (--restore)
+template <typename Balance>
+class CheckpointFile
+{
+public:
+    // Maps the checkpoint at path; false (after printing why) if it is not one of the books
+    // described by spec and numAccounts
+    bool open(const std::string &path, const BalanceSpec &spec, int numAccounts)
+    {
+        this->path = path;
+        int fd = ::open(path.c_str(), O_RDONLY);
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) != 0)
+        {
+            std::cerr << "Error: cannot open checkpoint '" << path << "': " << std::strerror(errno) << std::endl;
+            if (fd >= 0)
+            {
+                ::close(fd);
+            }
+            return false;
+        }
+        const std::size_t size = CHECKPOINT_DATA_OFFSET + static_cast<std::size_t>(numAccounts) * sizeof(Balance);
+        void *base = static_cast<std::size_t>(info.st_size) == size ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        ::close(fd); // the mapping keeps the file
+        if (base == MAP_FAILED)
+        {
+            std::cerr << "Error: '" << path << "' is not a checkpoint of " << numAccounts << " accounts with these balances (--balance)" << std::endl;
+            return false;
+        }
+        mapping = AccountMapping(base, size, static_cast<char *>(base) + CHECKPOINT_DATA_OFFSET);
+
+        std::memcpy(&header, base, sizeof(header));
+        CheckpointHeader expected = makeCheckpointHeader<Balance>(spec, numAccounts, header.lsn);
+        if (std::memcmp(&header, &expected, sizeof(header)) != 0)
+        {
+            std::cerr << "Error: checkpoint '" << path << "' was not taken of these accounts and balances (--balance, --balance-dist, "
+                      << "--balance-shape, --total, --seed)" << std::endl;
+            return false;
+        }
+        opened = true;
+        return true;
+    }
+
+    bool isOpen() const { return opened; }
+    const std::string &file() const { return path; }
+    std::uint64_t lsn() const { return header.lsn; }
+
+    // The balances, for a packed store to serve in place (see AccountStore)
+    AccountMapping takeBalances()
+    {
+        return std::move(mapping);
+    }
+
+    // Copies the balances into a store that cannot serve them in place (map, padded), one
+    // pass over the accounts
+    template <typename Accounts>
+    void copyTo(Accounts &bankAccounts)
+    {
+        const Balance *balances = static_cast<const Balance *>(mapping.data());
+        for (std::uint64_t i = 0; i < header.numAccounts; ++i)
+        {
+            storeBalance(bankAccounts[static_cast<int>(i + 1)], balances[i]);
+        }
+        mapping = AccountMapping();
+    }
+
+private:
+    std::string path;
+    CheckpointHeader header{};
+    AccountMapping mapping;
+    bool opened = false;
+};
+
+// Takes a checkpoint while the workers run (--checkpoint): every worker passes enter() and
+// leave() around each operation, and one of them calls take() between two of its own
+template <typename Accounts>
+class Checkpointer
+{
+public:
+    using Balance = BalanceOf<Accounts>;
+
+    Checkpointer(const Accounts &bankAccounts, const std::string &path, const BalanceSpec &spec, int numAccounts, int numWorkers,
+                 WriteAheadLog<Balance> *wal)
+        : bankAccounts(bankAccounts), path(path), tmpPath(path + ".tmp"),
+          directory(path.find('/') == std::string::npos ? "." : path.substr(0, path.rfind('/') + 1)),
+          header(makeCheckpointHeader<Balance>(spec, numAccounts, 0)), numAccounts(numAccounts), wal(wal),
+          workers(numWorkers), chunk(CHECKPOINT_CHUNK_ACCOUNTS) {}
+
+    ~Checkpointer()
+    {
+        wait();
+    }
+
+    Checkpointer(const Checkpointer &) = delete;
+    Checkpointer &operator=(const Checkpointer &) = delete;
+
+    void enter(int worker)
+    {
+        std::atomic<bool> &busy = workers[worker].busy;
+        while (true)
+        {
+            busy.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst); // announce the operation before looking at the gate (take() does the reverse)
+            if (!closed.load(std::memory_order_relaxed))
+            {
+                return;
+            }
+            busy.store(false, std::memory_order_release);
+            while (closed.load(std::memory_order_acquire))
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void leave(int worker)
+    {
+        workers[worker].busy.store(false, std::memory_order_release); // the operation's writes happen-before the checkpoint
+    }
+
+    // Closes the gate, waits until no worker is inside an operation, forks the writer and
+    // opens the gate again. False (see error()) if there is no writer.
+    bool take()
+    {
+        taken = true;
+        auto start = std::chrono::steady_clock::now();
+        closed.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        for (const auto &worker : workers)
+        {
+            while (worker.busy.load(std::memory_order_acquire))
+            {
+                std::this_thread::yield();
+            }
+        }
+        header.lsn = wal != nullptr ? wal->appendedLsn() : 0;
+        pid_t child = fork();
+        if (child == 0)
+        {
+            _exit(write() ? 0 : 1);
+        }
+        closed.store(false, std::memory_order_release);
+        auto forked = std::chrono::steady_clock::now();
+        pauseNs = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(forked - start).count());
+        if (child < 0)
+        {
+            failure = std::string("cannot fork the checkpoint writer: ") + std::strerror(errno);
+            return false;
+        }
+        waiter = std::thread([this, child, forked]
+                             {
+                                 int status = 0;
+                                 waitpid(child, &status, 0);
+                                 writeNs = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - forked).count());
+                                 if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+                                 {
+                                     failure = "could not write checkpoint '" + path + "'";
+                                 } });
+        return true;
+    }
+
+    bool wasTaken() const { return taken; }
+
+    // Waits for the writer; the statistics and error() are valid afterwards
+    void wait()
+    {
+        if (waiter.joinable())
+        {
+            waiter.join();
+        }
+    }
+
+    std::uint64_t lsn() const { return header.lsn; }
+    std::uint64_t pauseNanoseconds() const { return pauseNs; }
+    std::uint64_t writeNanoseconds() const { return writeNs; }
+    const std::string &error() const { return failure; }
+
+private:
+    struct alignas(CACHE_LINE_SIZE) Worker
+    {
+        std::atomic<bool> busy{false}; // inside an operation
+    };
+
+    // Runs in the forked child, which only has this thread: system calls on what the parent
+    // prepared, nothing allocated
+    bool write()
+    {
+        int fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            return childError("cannot create ", tmpPath);
+        }
+        char page[CHECKPOINT_DATA_OFFSET] = {};
+        std::memcpy(page, &header, sizeof(header));
+        bool written = writeAll(fd, page, sizeof(page));
+
+        Balance *balances = chunk.data();
+        std::size_t filled = 0;
+        written = written && forEachAccount(bankAccounts, 1, numAccounts, [&](int, const auto &balance)
+                                            {
+                                                balances[filled++] = loadBalance(balance);
+                                                if (filled < CHECKPOINT_CHUNK_ACCOUNTS)
+                                                {
+                                                    return true;
+                                                }
+                                                filled = 0;
+                                                return writeAll(fd, balances, CHECKPOINT_CHUNK_ACCOUNTS * sizeof(Balance)); });
+        written = written && writeAll(fd, balances, filled * sizeof(Balance)) && fdatasync(fd) == 0;
+        written = ::close(fd) == 0 && written;
+        if (!written)
+        {
+            return childError("cannot write ", tmpPath);
+        }
+        if (rename(tmpPath.c_str(), path.c_str()) != 0)
+        {
+            return childError("cannot rename it to ", path);
+        }
+        int dir = ::open(directory.c_str(), O_RDONLY); // make the rename durable too
+        if (dir >= 0)
+        {
+            fsync(dir);
+            ::close(dir);
+        }
+        return true;
+    }
+
+    static bool writeAll(int fd, const void *data, std::size_t size)
+    {
+        const char *bytes = static_cast<const char *>(data);
+        while (size > 0)
+        {
+            ssize_t written = ::write(fd, bytes, size);
+            if (written < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (written <= 0)
+            {
+                return false;
+            }
+            bytes += written;
+            size -= static_cast<std::size_t>(written);
+        }
+        return true;
+    }
+
+    static bool childError(const char *what, const std::string &file)
+    {
+        const char *parts[] = {"Error: checkpoint writer: ", what, file.c_str(), ": ", std::strerror(errno), "\n"};
+        for (const char *part : parts)
+        {
+            writeAll(STDERR_FILENO, part, std::strlen(part));
+        }
+        return false;
+    }
+
+    const Accounts &bankAccounts;
+    const std::string path;
+    const std::string tmpPath;
+    const std::string directory;
+    CheckpointHeader header;
+    const int numAccounts;
+    WriteAheadLog<Balance> *wal;
+
+    std::vector<Worker> workers;
+    std::atomic<bool> closed{false}; // the gate: no worker starts an operation while it is set
+    std::vector<Balance> chunk;      // the child's write buffer, allocated before the fork
+    bool taken = false;              // the rest is only touched by the worker taking the checkpoint, then the waiter
+    std::thread waiter;
+    std::uint64_t pauseNs = 0; // gate closed until the fork returned
+    std::uint64_t writeNs = 0; // fork until the child exited
+    std::string failure;
+};
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <atomic>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "balance_sum.h"
+#include "balance_types.h"
+#include "bank_options.h"
+#include "lock_profiler.h"
+
+// A synchronization engine is a class template over the account container (std::map or an
+// AccountStore of Balance, or of std::atomic<Balance> for the engines that need atomics) and
+// the lock types it uses (PlainLocks, or ProfiledLocks with --profile-locks):
+//
+//   template <typename Accounts, typename Locks = PlainLocks>
+//   class SomeEngine
+//   {
+//   public:
+//       // built after the accounts are populated and before the worker threads start
+//       SomeEngine(Accounts &bankAccounts, const BankOptions &options);
+//       // called concurrently by the workers 0..numThreads-1; true if the transfer was applied
+//       // (false: not enough funds). An engine that applies transfers after deposit() returns
+//       // returns void and cannot run with --wal (see durableDeposit())
+//       bool deposit(int worker, int account1, int account2, BalanceOf<Accounts> amount);
+//       BalanceOf<Accounts> balance(int worker);
+//       // one account, and the accounts first..last (inclusive), read as consistently as balance()
+//       BalanceOf<Accounts> get_balance(int worker, int account);
+//       BalanceOf<Accounts> range_balance(int worker, int first, int last);
+//       // counters, errors and lock profiles (profileLock()) collected after the workers have joined
+//       void report(EngineReport &report) const;
+//       // optional: applies consecutive transfers (OpType::Deposit operations) as one unit,
+//       // with the same per-transfer funds check as deposit() (see depositBatch())
+//       void deposit_batch(int worker, OperationBatch<BalanceOf<Accounts>> transfers);
+//       // optional: called by every worker after its last operation, for engines that hand
+//       // work to other threads (see finishWorker())
+//       void finish(int worker);
+//   };
+//
+// bank_bench.cpp lists the engines it can run (--engine=NAME).
+
+// What an engine reports after a run: named counters (audit retries, ...), errors and, with
+// --profile-locks, the counters of every lock it owns
+struct EngineReport
+{
+    std::vector<std::pair<std::string, double>> counters;
+    std::vector<std::string> errors;
+    std::vector<LockProfile> locks;
+};
+
+// Calls engine.deposit_batch(worker, transfers) if the engine has one, else deposit() for
+// each transfer in order
+template <typename Engine, typename Balance>
+auto depositBatch(Engine &engine, int worker, OperationBatch<Balance> transfers, int) -> decltype(engine.deposit_batch(worker, transfers))
+{
+    engine.deposit_batch(worker, transfers);
+}
+
+template <typename Engine, typename Balance>
+void depositBatch(Engine &engine, int worker, OperationBatch<Balance> transfers, long)
+{
+    for (const auto &transfer : transfers)
+    {
+        engine.deposit(worker, transfer.from, transfer.to, transfer.amount);
+    }
+}
+
+// Calls engine.finish(worker) if the engine has one: it must not return before every
+// operation the worker started has been applied
+template <typename Engine>
+auto finishWorker(Engine &engine, int worker, int) -> decltype(engine.finish(worker))
+{
+    engine.finish(worker);
+}
+
+template <typename Engine>
+void finishWorker(Engine &, int, long) {}
+
+// Account value types, chosen per engine in the registry
+template <typename Balance>
+using PlainAccount = Balance;
+template <typename Balance>
+using AtomicAccount = std::atomic<Balance>;
+
+// The unsynchronized single-threaded versions of deposit(), balance(), get_balance() and
+// range_balance(), shared by the engines and by the single-threaded baseline run
+template <typename Accounts>
+void single_deposit(Accounts &bankAccounts, int account1, int account2, BalanceOf<Accounts> amount)
+{
+    // check if the account1 has enough funds (greater than amount)
+    BalanceOf<Accounts> funds = loadBalance(bankAccounts[account1]);
+    if (funds > amount)
+    {
+        // Perform the deposit only if there are sufficient funds
+        storeBalance(bankAccounts[account1], funds - amount);
+        storeBalance(bankAccounts[account2], loadBalance(bankAccounts[account2]) + amount);
+    }
+}
+
+template <typename Accounts>
+BalanceOf<Accounts> single_balance(Accounts &bankAccounts)
+{
+    return sumBalances(bankAccounts); // sum up the balances of all accounts (vectorized on a packed store)
+}
+
+template <typename Accounts>
+BalanceOf<Accounts> single_get_balance(Accounts &bankAccounts, int account)
+{
+    return loadBalance(bankAccounts[account]);
+}
+
+template <typename Accounts>
+BalanceOf<Accounts> single_range_balance(Accounts &bankAccounts, int first, int last)
+{
+    return sumBalances(bankAccounts, first, last); // sum up the balances of accounts first..last
+}
+
+#endif
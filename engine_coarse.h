@@ -0,0 +1,81 @@
+#ifndef ENGINE_COARSE_H
+#define ENGINE_COARSE_H
+
+#include <mutex>
+
+#include "audit_pool.h"
+#include "balance_types.h"
+#include "bank_options.h"
+#include "engine.h"
+#include "lock_profiler.h"
+
+// One mutex for the whole bank: every deposit() and balance() runs alone
+template <typename Accounts, typename Locks = PlainLocks>
+class CoarseLocksEngine
+{
+public:
+    using Balance = BalanceOf<Accounts>;
+
+    CoarseLocksEngine(Accounts &bankAccounts, const BankOptions &options)
+        : bankAccounts(bankAccounts), auditPool(options.auditThreads) {}
+
+    bool deposit(int, int account1, int account2, Balance amount)
+    {
+        std::lock_guard<typename Locks::Mutex> lock(bankMutex); // Lock everything
+        // check balance *inside* critical section and return early if insufficient funds
+        if (bankAccounts[account1] < amount)
+        {
+            return false; // Locks will be released automatically when function exits
+        }
+
+        // dp the transfer
+        bankAccounts[account1] -= amount;
+        bankAccounts[account2] += amount;
+        return true;
+    }
+
+    // the whole batch under one acquisition of bankMutex
+    void deposit_batch(int, OperationBatch<Balance> transfers)
+    {
+        std::lock_guard<typename Locks::Mutex> lock(bankMutex); // Lock everything
+        for (const auto &transfer : transfers)
+        {
+            if (bankAccounts[transfer.from] >= transfer.amount)
+            {
+                bankAccounts[transfer.from] -= transfer.amount;
+                bankAccounts[transfer.to] += transfer.amount;
+            }
+        }
+    }
+
+    Balance balance(int)
+    {
+        std::lock_guard<typename Locks::Mutex> lock(bankMutex); // Lock everything
+        Balance total = parallelSumBalances(auditPool, bankAccounts); // sum up the balances of all accounts
+        return total;
+    }
+
+    Balance get_balance(int, int account)
+    {
+        std::lock_guard<typename Locks::Mutex> lock(bankMutex); // Lock everything
+        return bankAccounts[account];
+    }
+
+    Balance range_balance(int, int first, int last)
+    {
+        std::lock_guard<typename Locks::Mutex> lock(bankMutex); // Lock everything
+        return sumBalances(bankAccounts, first, last);         // sum up the balances of accounts first..last
+    }
+
+    void report(EngineReport &report) const
+    {
+        profileLock(report.locks, "bankMutex", bankMutex);
+    }
+
+private:
+    Accounts &bankAccounts;
+    typename Locks::Mutex bankMutex; // Coarse-grained mutex for all account operations
+    AuditPool auditPool;             // helper threads for balance() (--audit-threads)
+};
+
+#endif
@@ -0,0 +1,164 @@
+#ifndef ENGINE_COMBINING_H
+#define ENGINE_COMBINING_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "account_store.h"
+#include "audit_pool.h"
+#include "balance_types.h"
+#include "bank_options.h"
+#include "engine.h"
+
+// Flat combining over the coarse engine's single lock: a worker publishes its deposit() or
+// read (balance(), get_balance(), range_balance()) in its own request slot and then either
+// becomes the combiner (it got the lock) or waits for its slot to be answered. The combiner
+// applies every pending request of every worker in one pass while the accounts are hot in
+// its cache, so the lock changes hands once per batch instead of once per operation.
+template <typename Accounts, typename Locks = PlainLocks>
+class CombiningEngine
+{
+public:
+    using Balance = BalanceOf<Accounts>;
+
+    CombiningEngine(Accounts &bankAccounts, const BankOptions &options)
+        : bankAccounts(bankAccounts), slots(options.numThreads), auditPool(options.auditThreads) {}
+
+    bool deposit(int worker, int account1, int account2, Balance amount)
+    {
+        Slot &slot = slots[worker];
+        slot.type = OpType::Deposit;
+        slot.from = account1;
+        slot.to = account2;
+        slot.amount = amount;
+        submit(slot);
+        return slot.applied;
+    }
+
+    Balance balance(int worker)
+    {
+        Slot &slot = slots[worker];
+        slot.type = OpType::Balance;
+        submit(slot);
+        return slot.result;
+    }
+
+    Balance get_balance(int worker, int account)
+    {
+        return range_balance(worker, account, account);
+    }
+
+    Balance range_balance(int worker, int first, int last)
+    {
+        Slot &slot = slots[worker];
+        slot.type = OpType::RangeBalance;
+        slot.from = first;
+        slot.to = last;
+        submit(slot);
+        return slot.result;
+    }
+
+    // how many requests a combiner pass applied on average
+    void report(EngineReport &report) const
+    {
+        report.counters.emplace_back("combiner_passes", static_cast<double>(passes));
+        report.counters.emplace_back("combined_requests", static_cast<double>(combined));
+        report.counters.emplace_back("requests_per_pass", passes == 0 ? 0.0 : static_cast<double>(combined) / passes);
+        profileLock(report.locks, "combinerLock", combinerLock);
+    }
+
+private:
+    static constexpr int MAX_PASSES = 4; // passes a combiner makes while it keeps finding requests
+
+    // One per worker, written by its worker until pending is set and by the combiner after
+    struct alignas(CACHE_LINE_SIZE) Slot
+    {
+        std::atomic<bool> pending{false}; // request published, not yet applied
+        OpType type = OpType::Deposit;
+        int from = 0; // deposit: account debited; range_balance: first account
+        int to = 0;   // deposit: account credited; range_balance: last account
+        Balance amount = 0;
+        Balance result = 0;   // balance() or range_balance() total
+        bool applied = false; // deposit() had the funds
+    };
+
+    // Publishes the request and returns once some combiner (maybe this worker) applied it
+    void submit(Slot &slot)
+    {
+        slot.pending.store(true, std::memory_order_release);
+        while (slot.pending.load(std::memory_order_acquire))
+        {
+            if (combinerLock.try_lock())
+            {
+                combine();
+                combinerLock.unlock();
+            }
+            else
+            {
+                std::this_thread::yield(); // the combiner is running, it will most likely pick us up
+            }
+        }
+    }
+
+    // Applies every pending request, called with combinerLock held
+    void combine()
+    {
+        for (int pass = 0; pass < MAX_PASSES; ++pass)
+        {
+            std::uint64_t applied = 0;
+            bool haveTotal = false; // total stays valid until a deposit changes the accounts
+            Balance total = 0;
+            for (auto &slot : slots)
+            {
+                if (!slot.pending.load(std::memory_order_acquire))
+                {
+                    continue;
+                }
+                if (slot.type == OpType::Deposit)
+                {
+                    // same check and transfer as the coarse engine, inside the critical section
+                    slot.applied = bankAccounts[slot.from] >= slot.amount;
+                    if (slot.applied)
+                    {
+                        bankAccounts[slot.from] -= slot.amount;
+                        bankAccounts[slot.to] += slot.amount;
+                        haveTotal = false;
+                    }
+                }
+                else if (slot.type == OpType::RangeBalance)
+                {
+                    slot.result = sumBalances(bankAccounts, slot.from, slot.to);
+                }
+                else
+                {
+                    if (!haveTotal)
+                    {
+                        total = parallelSumBalances(auditPool, bankAccounts);
+                        haveTotal = true;
+                    }
+                    slot.result = total;
+                }
+                slot.pending.store(false, std::memory_order_release); // hand the answer back
+                ++applied;
+            }
+            if (applied == 0)
+            {
+                break;
+            }
+            ++passes;
+            combined += applied;
+        }
+    }
+
+    Accounts &bankAccounts;
+    std::vector<Slot> slots;            // one per worker thread
+    typename Locks::Mutex combinerLock; // held by the thread combining the requests
+    std::uint64_t passes = 0;           // combiner passes that applied something (under combinerLock)
+    std::uint64_t combined = 0;         // requests applied (under combinerLock)
+    AuditPool auditPool;                // helper threads for balance() (--audit-threads)
+};
+
+#endif
@@ -0,0 +1,367 @@
+#ifndef ENGINE_DELEGATION_H
+#define ENGINE_DELEGATION_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "account_store.h"
+#include "audit_pool.h"
+#include "balance_types.h"
+#include "bank_options.h"
+#include "engine.h"
+#include "spsc_ring.h"
+
+// Every worker owns a shard (a contiguous block of account IDs) and is the only thread that
+// ever writes its accounts, so a transfer inside the caller's shard runs with no lock and no
+// atomic read-modify-write. Anything else is delegated over bounded SPSC rings (one per
+// sender/owner pair) in two steps that never create or lose money:
+//   1. Debit: the owner of the source account checks the funds and debits it,
+//   2. Credit: the owner of the destination credits it (directly if it owns both accounts).
+// Between the two steps the money sits in the sending shard's creditsSent ledger and not
+// yet in the receiving shard's creditsApplied. Owners poll their rings every few deposits
+// and when they wait, so deposit() returns as soon as the work is handed over; finish()
+// keeps every worker serving its rings until no message is left anywhere.
+//
+// Each shard has a sequence number that is odd while its owner changes its accounts or
+// ledgers. balance() sums all accounts plus the money in flight and accepts the total only
+// if no sequence was odd or moved, i.e. it read a consistent cut (as in the seqlock engine).
+template <typename Accounts, typename Locks = PlainLocks>
+class DelegationEngine
+{
+public:
+    using Balance = BalanceOf<Accounts>;
+
+    DelegationEngine(Accounts &bankAccounts, const BankOptions &options)
+        : bankAccounts(bankAccounts), numAccounts(options.numAccounts), numShards(options.numThreads), shards(numShards),
+          auditPool(options.auditThreads)
+    {
+        for (int i = 0; i < numShards * numShards; ++i)
+        {
+            rings.emplace_back(new Ring());
+        }
+    }
+
+    void deposit(int worker, int account1, int account2, Balance amount)
+    {
+        Shard &shard = shards[worker];
+        if (++shard.depositsSincePoll == POLL_INTERVAL)
+        {
+            poll(worker);
+        }
+
+        int owner = shardOf(account1);
+        if (owner != worker)
+        {
+            ++shard.delegatedDebits;
+            send(worker, owner, Message{amount, account1, account2, MessageKind::Debit});
+            return;
+        }
+        beginUpdate(shard);
+        debit(worker, Message{amount, account1, account2, MessageKind::Debit});
+        endUpdate(shard);
+    }
+
+    Balance balance(int worker)
+    {
+        ++shards[worker].audits;
+        Balance total = 0;
+        bool quiescent = false;
+        while (!snapshot(total, quiescent))
+        {
+            ++shards[worker].auditRetries; // an owner changed its shard while it was summed, try again
+            poll(worker);                  // serve our own rings meanwhile, others may be waiting on them
+            std::this_thread::yield();
+        }
+        return total;
+    }
+
+    // An account is written by its owner alone, one store per change, so a single load is enough
+    Balance get_balance(int, int account)
+    {
+        return bankAccounts[account].load(std::memory_order_acquire);
+    }
+
+    // The accounts first..last under the same cut as balance(); money in flight towards them
+    // is not theirs yet
+    Balance range_balance(int worker, int first, int last)
+    {
+        thread_local std::vector<std::uint64_t> sequences;
+        while (true)
+        {
+            if (quietShards(sequences))
+            {
+                Balance total = sumBalances(bankAccounts, first, last);
+                std::atomic_thread_fence(std::memory_order_acquire); // finish reading the accounts before re-reading the sequences
+                if (unchangedShards(sequences))
+                {
+                    return total;
+                }
+            }
+            ++shards[worker].auditRetries; // an owner changed its shard while the range was summed, try again
+            poll(worker);
+            std::this_thread::yield();
+        }
+    }
+
+    // Called by every worker after its last operation: serve the rings until all workers are
+    // done and no debit or credit is left in flight
+    void finish(int worker)
+    {
+        finishedWorkers.fetch_add(1, std::memory_order_acq_rel);
+        while (true)
+        {
+            poll(worker);
+            if (finishedWorkers.load(std::memory_order_acquire) == numShards && shards[worker].pending.empty())
+            {
+                Balance total = 0;
+                bool quiescent = false;
+                if (snapshot(total, quiescent) && quiescent)
+                {
+                    return;
+                }
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    void report(EngineReport &report) const
+    {
+        std::uint64_t delegatedDebits = 0, forwardedCredits = 0, ringFullWaits = 0, audits = 0, auditRetries = 0;
+        for (const auto &shard : shards)
+        {
+            delegatedDebits += shard.delegatedDebits;
+            forwardedCredits += shard.forwardedCredits;
+            ringFullWaits += shard.ringFullWaits;
+            audits += shard.audits;
+            auditRetries += shard.auditRetries;
+        }
+        report.counters.emplace_back("delegated_debits", static_cast<double>(delegatedDebits));
+        report.counters.emplace_back("forwarded_credits", static_cast<double>(forwardedCredits));
+        report.counters.emplace_back("ring_full_waits", static_cast<double>(ringFullWaits));
+        report.counters.emplace_back("balance_calls", static_cast<double>(audits));
+        report.counters.emplace_back("audit_retries", static_cast<double>(auditRetries));
+    }
+
+private:
+    static constexpr int POLL_INTERVAL = 8;          // deposits between two polls of the rings
+    static constexpr std::size_t RING_CAPACITY = 256; // messages per sender/owner ring
+
+    enum class MessageKind : std::uint8_t
+    {
+        Debit, // to the owner of from: debit from, then credit to
+        Credit // to the owner of to: the money is already debited
+    };
+
+    struct Message
+    {
+        Balance amount;
+        std::int32_t from;
+        std::int32_t to;
+        MessageKind kind;
+    };
+
+    using Ring = SpscRing<Message, RING_CAPACITY>;
+
+    // Written only by its owner; the atomics are also read by balance() and finish()
+    struct alignas(CACHE_LINE_SIZE) Shard
+    {
+        std::atomic<std::uint64_t> sequence{0};         // odd while the owner changes the shard
+        std::atomic<Balance> creditsSent{0};            // money debited here and sent to other shards
+        std::atomic<Balance> creditsApplied{0};         // money received from other shards
+        std::atomic<std::uint64_t> messagesSent{0};     // messages pushed (or queued in pending)
+        std::atomic<std::uint64_t> messagesReceived{0}; // messages popped and applied
+        std::vector<std::pair<int, Message>> pending;   // credits whose ring was full, retried on every poll
+        int depositsSincePoll = 0;
+        std::uint64_t delegatedDebits = 0;  // deposits whose source account lives in another shard
+        std::uint64_t forwardedCredits = 0; // debits whose destination lives in another shard
+        std::uint64_t ringFullWaits = 0;    // deposit() found the owner's ring full and had to wait
+        std::uint64_t audits = 0;           // balance() calls made by this worker
+        std::uint64_t auditRetries = 0;     // balance() attempts that overlapped a shard update
+    };
+
+    // Shard s owns the accounts numAccounts * s / numShards + 1 .. numAccounts * (s + 1) / numShards
+    int shardOf(int account) const
+    {
+        return static_cast<int>(static_cast<std::int64_t>(account - 1) * numShards / numAccounts);
+    }
+
+    Ring &ring(int sender, int owner) { return *rings[owner * numShards + sender]; }
+
+    template <typename T>
+    static void addOwned(std::atomic<T> &value, T delta)
+    {
+        value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed); // single writer, no RMW needed
+    }
+
+    void beginUpdate(Shard &shard)
+    {
+        shard.sequence.store(shard.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); // odd: shard changing
+        std::atomic_thread_fence(std::memory_order_release);                                                   // publish it before touching the shard
+    }
+
+    void endUpdate(Shard &shard)
+    {
+        shard.sequence.store(shard.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release); // even: shard consistent
+    }
+
+    // Step 1 at the owner of msg.from, inside its update
+    void debit(int worker, const Message &msg)
+    {
+        Shard &shard = shards[worker];
+        Balance funds = bankAccounts[msg.from].load(std::memory_order_relaxed);
+        if (funds < msg.amount)
+        {
+            return; // insufficient funds, nothing moves
+        }
+        bankAccounts[msg.from].store(funds - msg.amount, std::memory_order_relaxed);
+
+        int owner = shardOf(msg.to);
+        if (owner == worker)
+        {
+            addOwned(bankAccounts[msg.to], msg.amount);
+            return;
+        }
+        // step 2 goes to the destination's owner; the money stays on our ledger until it is applied
+        ++shard.forwardedCredits;
+        addOwned(shard.creditsSent, msg.amount);
+        addOwned(shard.messagesSent, std::uint64_t{1});
+        Message credit{msg.amount, msg.from, msg.to, MessageKind::Credit};
+        if (!ring(worker, owner).push(credit))
+        {
+            shard.pending.emplace_back(owner, credit); // never block inside an update
+        }
+    }
+
+    // Hands a debit to the owner of its source account, serving our own rings while its ring is full
+    void send(int worker, int owner, const Message &msg)
+    {
+        Shard &shard = shards[worker];
+        while (true)
+        {
+            beginUpdate(shard);
+            bool sent = ring(worker, owner).push(msg);
+            if (sent)
+            {
+                addOwned(shard.messagesSent, std::uint64_t{1});
+            }
+            endUpdate(shard);
+            if (sent)
+            {
+                return;
+            }
+            ++shard.ringFullWaits;
+            poll(worker);
+            std::this_thread::yield();
+        }
+    }
+
+    // Applies every message waiting for this worker's shard and retries the pending credits
+    void poll(int worker)
+    {
+        Shard &shard = shards[worker];
+        shard.depositsSincePoll = 0;
+        beginUpdate(shard);
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < shard.pending.size(); ++i)
+        {
+            if (!ring(worker, shard.pending[i].first).push(shard.pending[i].second))
+            {
+                shard.pending[kept++] = shard.pending[i];
+            }
+        }
+        shard.pending.resize(kept);
+
+        Message msg;
+        for (int sender = 0; sender < numShards; ++sender)
+        {
+            if (sender == worker)
+            {
+                continue;
+            }
+            Ring &inbox = ring(sender, worker);
+            while (inbox.pop(msg))
+            {
+                if (msg.kind == MessageKind::Debit)
+                {
+                    debit(worker, msg);
+                }
+                else // step 2 for a debit made by another shard
+                {
+                    addOwned(bankAccounts[msg.to], msg.amount);
+                    addOwned(shard.creditsApplied, msg.amount);
+                }
+                addOwned(shard.messagesReceived, std::uint64_t{1});
+            }
+        }
+        endUpdate(shard);
+    }
+
+    // Sums the accounts plus the money in flight; false if a shard changed meanwhile.
+    // quiescent is set when no message is left in any ring or pending queue.
+    bool snapshot(Balance &total, bool &quiescent)
+    {
+        thread_local std::vector<std::uint64_t> sequences;
+        if (!quietShards(sequences))
+        {
+            return false;
+        }
+
+        total = parallelSumBalances(auditPool, bankAccounts); // sum up the balances of all accounts
+        std::uint64_t sent = 0, received = 0;
+        for (const auto &shard : shards)
+        {
+            total += shard.creditsSent.load(std::memory_order_relaxed) - shard.creditsApplied.load(std::memory_order_relaxed);
+            sent += shard.messagesSent.load(std::memory_order_relaxed);
+            received += shard.messagesReceived.load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire); // finish reading the shards before re-reading the sequences
+
+        if (!unchangedShards(sequences))
+        {
+            return false;
+        }
+        quiescent = sent == received;
+        return true;
+    }
+
+    // Reads every shard's sequence; false if an owner is changing its shard
+    bool quietShards(std::vector<std::uint64_t> &sequences) const
+    {
+        sequences.resize(shards.size());
+        for (std::size_t s = 0; s < shards.size(); ++s)
+        {
+            sequences[s] = shards[s].sequence.load(std::memory_order_acquire);
+            if (sequences[s] % 2 != 0)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // True if no shard changed since quietShards() read the sequences
+    bool unchangedShards(const std::vector<std::uint64_t> &sequences) const
+    {
+        for (std::size_t s = 0; s < shards.size(); ++s)
+        {
+            if (shards[s].sequence.load(std::memory_order_relaxed) != sequences[s])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    Accounts &bankAccounts;
+    const int numAccounts;
+    const int numShards;                      // one per worker thread
+    std::vector<Shard> shards;                // indexed by worker
+    std::vector<std::unique_ptr<Ring>> rings; // rings[owner * numShards + sender]
+    std::atomic<int> finishedWorkers{0};
+    AuditPool auditPool;                      // helper threads for balance() (--audit-threads)
+};
+
+#endif
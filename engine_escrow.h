@@ -0,0 +1,311 @@
+#ifndef ENGINE_ESCROW_H
+#define ENGINE_ESCROW_H
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "account_store.h"
+#include "audit_pool.h"
+#include "balance_types.h"
+#include "bank_options.h"
+#include "engine.h"
+#include "lock_table.h"
+
+// Escrow (demarcation protocol): every account's money is split between its shared balance
+// (the std::atomic in bankAccounts) and slices escrowed by the workers. A withdrawal that
+// fits in the worker's own slice of the source account commits locally, with no atomic
+// read-modify-write and no shared cache line. Only when the slice runs dry does the worker
+// take a new one from the shared balance (a CAS), and it hands money back when a slice grows
+// past its limit or its table slot is needed for another account. Credits go into the
+// worker's slice of the destination account up to that limit.
+//
+// A withdrawal is refused when the shared balance plus the worker's own slice cannot cover
+// it, even if slices escrowed by other workers could: that is the price of never asking
+// them. Slices are at most 1/(2 * threads) of the shared balance plus the amount needed, so
+// most of an account's money stays shared.
+//
+// Each worker has a sequence number that is odd while it changes its slices or the shared
+// balances. balance() sums the shared balances and every slice and accepts the total only if
+// no sequence was odd or moved (a consistent cut, as in the seqlock engine). finish() hands
+// all slices back, so after the run every dollar is in bankAccounts again.
+template <typename Accounts, typename Locks = PlainLocks>
+class EscrowEngine
+{
+public:
+    using Balance = BalanceOf<Accounts>;
+
+    EscrowEngine(Accounts &bankAccounts, const BankOptions &options)
+        : bankAccounts(bankAccounts), numThreads(options.numThreads), workers(options.numThreads), auditPool(options.auditThreads)
+    {
+        std::size_t slots = std::min(roundUpToPowerOfTwo(static_cast<std::size_t>(options.numAccounts) + 1), MAX_ESCROW_SLOTS);
+        for (auto &worker : workers)
+        {
+            worker.slices = std::vector<Slice>(slots);
+        }
+    }
+
+    bool deposit(int worker, int account1, int account2, Balance amount)
+    {
+        Worker &self = workers[worker];
+        beginUpdate(self);
+        bool applied = withdraw(self, account1, amount);
+        if (applied)
+        {
+            credit(self, account2, amount);
+        }
+        endUpdate(self);
+        return applied;
+    }
+
+    Balance balance(int worker)
+    {
+        ++workers[worker].audits;
+        return consistent(workers[worker], [this]
+                          {
+                              Balance total = parallelSumBalances(auditPool, bankAccounts); // sum up the shared balances
+                              for (const auto &other : workers)
+                              {
+                                  for (const auto &slice : other.slices)
+                                  {
+                                      total += slice.amount.load(std::memory_order_relaxed); // and every escrowed slice
+                                  }
+                              }
+                              return total; });
+    }
+
+    // An account's money is its shared balance plus the workers' slices of it, read under the
+    // same consistent cut as balance()
+    Balance get_balance(int worker, int account)
+    {
+        return consistent(workers[worker], [this, account]
+                          { return escrowed(account, account); });
+    }
+
+    Balance range_balance(int worker, int first, int last)
+    {
+        return consistent(workers[worker], [this, first, last]
+                          { return escrowed(first, last); });
+    }
+
+    // Hands every slice back to the shared balances
+    void finish(int worker)
+    {
+        Worker &self = workers[worker];
+        beginUpdate(self);
+        for (auto &slice : self.slices)
+        {
+            release(self, slice);
+        }
+        endUpdate(self);
+    }
+
+    void report(EngineReport &report) const
+    {
+        std::uint64_t localWithdrawals = 0, refills = 0, returns = 0, refused = 0, audits = 0, auditRetries = 0;
+        for (const auto &worker : workers)
+        {
+            localWithdrawals += worker.localWithdrawals;
+            refills += worker.refills;
+            returns += worker.returns;
+            refused += worker.refused;
+            audits += worker.audits;
+            auditRetries += worker.auditRetries;
+        }
+        report.counters.emplace_back("local_withdrawals", static_cast<double>(localWithdrawals));
+        report.counters.emplace_back("escrow_refills", static_cast<double>(refills));
+        report.counters.emplace_back("escrow_returns", static_cast<double>(returns));
+        report.counters.emplace_back("refused_withdrawals", static_cast<double>(refused));
+        report.counters.emplace_back("balance_calls", static_cast<double>(audits));
+        report.counters.emplace_back("audit_retries", static_cast<double>(auditRetries));
+    }
+
+private:
+    static constexpr std::size_t MAX_ESCROW_SLOTS = 4096; // slices a worker holds at once (direct-mapped by account ID)
+
+    // A worker's escrowed slice of one account; amount is also read by balance(), account by
+    // get_balance() and range_balance()
+    struct Slice
+    {
+        std::atomic<int> account{0};  // 0: slot unused (account IDs start at 1)
+        Balance limit = 0;            // credits above this go back to the shared balance
+        std::atomic<Balance> amount{0};
+    };
+
+    struct alignas(CACHE_LINE_SIZE) Worker
+    {
+        std::atomic<std::uint64_t> sequence{0}; // odd while this worker changes its escrow or a shared balance
+        std::vector<Slice> slices;               // indexed by account ID mod size
+        std::uint64_t localWithdrawals = 0;      // withdrawals served from a slice alone
+        std::uint64_t refills = 0;               // slices topped up from a shared balance
+        std::uint64_t returns = 0;               // money handed back to a shared balance
+        std::uint64_t refused = 0;               // withdrawals the shared balance plus the slice could not cover
+        std::uint64_t audits = 0;                // balance() calls made by this worker
+        std::uint64_t auditRetries = 0;          // balance() and account reads that overlapped an escrow change
+    };
+
+    void beginUpdate(Worker &self)
+    {
+        self.sequence.store(self.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); // odd: escrow changing
+        std::atomic_thread_fence(std::memory_order_release);                                                 // publish it before touching any balance
+    }
+
+    void endUpdate(Worker &self)
+    {
+        self.sequence.store(self.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release); // even: escrow consistent
+    }
+
+    // Runs sum() until no worker changed its escrow or a shared balance while it ran
+    template <typename Sum>
+    Balance consistent(Worker &self, Sum sum)
+    {
+        thread_local std::vector<std::uint64_t> sequences;
+        sequences.resize(workers.size());
+        while (true)
+        {
+            bool quiet = true;
+            for (std::size_t w = 0; w < workers.size() && quiet; ++w)
+            {
+                sequences[w] = workers[w].sequence.load(std::memory_order_acquire);
+                quiet = sequences[w] % 2 == 0;
+            }
+
+            if (quiet)
+            {
+                Balance total = sum();
+                std::atomic_thread_fence(std::memory_order_acquire); // finish reading before re-reading the sequences
+
+                bool unchanged = true;
+                for (std::size_t w = 0; w < workers.size() && unchanged; ++w)
+                {
+                    unchanged = workers[w].sequence.load(std::memory_order_relaxed) == sequences[w];
+                }
+                if (unchanged)
+                {
+                    return total;
+                }
+            }
+
+            ++self.auditRetries; // a worker changed its escrow while it was summed, try again
+            std::this_thread::yield();
+        }
+    }
+
+    // Shared balances of the accounts first..last plus every worker's slices of them: through
+    // each account's slot for a short range, through all slots otherwise
+    Balance escrowed(int first, int last) const
+    {
+        Balance total = sumBalances(bankAccounts, first, last);
+        for (const auto &other : workers)
+        {
+            const std::size_t slots = other.slices.size();
+            if (static_cast<std::size_t>(last - first) < slots)
+            {
+                for (int account = first; account <= last; ++account)
+                {
+                    const Slice &slice = other.slices[static_cast<std::size_t>(account) & (slots - 1)];
+                    if (slice.account.load(std::memory_order_relaxed) == account)
+                    {
+                        total += slice.amount.load(std::memory_order_relaxed);
+                    }
+                }
+                continue;
+            }
+            for (const auto &slice : other.slices)
+            {
+                int account = slice.account.load(std::memory_order_relaxed);
+                if (account >= first && account <= last)
+                {
+                    total += slice.amount.load(std::memory_order_relaxed);
+                }
+            }
+        }
+        return total;
+    }
+
+    // The worker's slice of account, after handing back the slice of whatever account held the slot
+    Slice &sliceOf(Worker &self, int account)
+    {
+        Slice &slice = self.slices[static_cast<std::size_t>(account) & (self.slices.size() - 1)];
+        if (slice.account.load(std::memory_order_relaxed) != account)
+        {
+            release(self, slice);
+            slice.account.store(account, std::memory_order_relaxed);
+            slice.limit = 0;
+        }
+        return slice;
+    }
+
+    void release(Worker &self, Slice &slice)
+    {
+        Balance amount = slice.amount.load(std::memory_order_relaxed);
+        if (amount != 0)
+        {
+            atomicAddBalance(bankAccounts[slice.account.load(std::memory_order_relaxed)], amount);
+            slice.amount.store(0, std::memory_order_relaxed);
+            ++self.returns;
+        }
+    }
+
+    bool withdraw(Worker &self, int account, Balance amount)
+    {
+        Slice &slice = sliceOf(self, account);
+        Balance local = slice.amount.load(std::memory_order_relaxed);
+        if (local >= amount)
+        {
+            slice.amount.store(local - amount, std::memory_order_relaxed); // fits in our slice: nothing shared is touched
+            ++self.localWithdrawals;
+            return true;
+        }
+
+        // refill: take what is missing plus a share of the shared balance for the next withdrawals
+        std::atomic<Balance> &shared = bankAccounts[account];
+        Balance available = shared.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Balance needed = amount - local;
+            if (available < needed)
+            {
+                ++self.refused;
+                return false;
+            }
+            Balance share = available / (2 * numThreads);
+            if (std::is_floating_point<Balance>::value)
+            {
+                share = std::floor(share); // whole dollars: fractional float slices round when folded back and lose money
+            }
+            Balance take = std::min(available, needed + share);
+            if (shared.compare_exchange_weak(available, available - take, std::memory_order_relaxed))
+            {
+                slice.amount.store(local + take - amount, std::memory_order_relaxed);
+                slice.limit = 2 * take;
+                ++self.refills;
+                return true;
+            }
+        }
+    }
+
+    void credit(Worker &self, int account, Balance amount)
+    {
+        Slice &slice = sliceOf(self, account);
+        Balance local = slice.amount.load(std::memory_order_relaxed) + amount;
+        if (local > slice.limit)
+        {
+            atomicAddBalance(bankAccounts[account], local - slice.limit); // keep slices small, the rest belongs to everyone
+            local = slice.limit;
+            ++self.returns;
+        }
+        slice.amount.store(local, std::memory_order_relaxed);
+    }
+
+    Accounts &bankAccounts;
+    const int numThreads;
+    std::vector<Worker> workers; // one per worker thread
+    AuditPool auditPool;         // helper threads for balance() (--audit-threads)
+};
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef ENGINE_FAST_H
+#define ENGINE_FAST_H
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+#include "audit_pool.h"
+#include "balance_types.h"
+#include "bank_options.h"
+#include "engine.h"
+#include "lock_profiler.h"
+#include "lock_table.h"
+
+// Phase gate: audits and transfers alternate in batched phases.
+// balance() announces itself in balanceRunning, which closes the gate for new deposits, and
+// waits for the deposits already inside (depositsRunning) to drain. All audits that arrive
+// while the gate is closed run together; when balanceRunning drops back to zero the waiting
+// deposits are let through together. Deposits only exclude each other per account.
+template <typename Accounts, typename Locks = PlainLocks>
+class FastLocksEngine
+{
+public:
+    using Balance = BalanceOf<Accounts>;
+
+    FastLocksEngine(Accounts &bankAccounts, const BankOptions &options)
+        : bankAccounts(bankAccounts), accountLocks(options.lockStripes), globalBalance(single_balance(bankAccounts)),
+          auditPool(options.auditThreads) {}
+
+    bool deposit(int, int account1, int account2, Balance amount)
+    {
+        bool applied = false;
+        enterDepositPhase();
+        {
+            BasicStripePairLock<BasicStripedLockTable<typename Locks::Mutex>> lock(accountLocks, account1, account2); // lock both stripes in index order to prevent deadlocks
+
+            if (bankAccounts[account1] >= amount)
+            {
+                bankAccounts[account1] -= amount;
+                bankAccounts[account2] += amount;
+                applied = true;
+            }
+        }
+        depositsRunning.fetch_sub(1, std::memory_order_release); // Leave the transfer phase (after the locks are released)
+        return applied;
+    }
+
+    // one pass through the gate and one acquisition of every stripe the batch touches, so an
+    // audit waits for the whole batch
+    void deposit_batch(int, OperationBatch<Balance> transfers)
+    {
+        enterDepositPhase();
+        {
+            BasicStripeSetLock<BasicStripedLockTable<typename Locks::Mutex>> lock(accountLocks, transfers);
+            for (const auto &transfer : transfers)
+            {
+                if (bankAccounts[transfer.from] >= transfer.amount)
+                {
+                    bankAccounts[transfer.from] -= transfer.amount;
+                    bankAccounts[transfer.to] += transfer.amount;
+                }
+            }
+        }
+        depositsRunning.fetch_sub(1, std::memory_order_release); // Leave the transfer phase (after the locks are released)
+    }
+
+    Balance balance(int)
+    {
+        balanceRunning.fetch_add(1, std::memory_order_seq_cst); // Increment balanceRunning: closes the gate for new deposits
+        while (depositsRunning.load(std::memory_order_seq_cst) != 0)
+        {
+            std::this_thread::yield(); // let the deposits already inside finish
+        }
+
+        Balance total = parallelSumBalances(auditPool, bankAccounts); // Sum up the balances of all accounts
+        // only cents sum exactly: float totals drift from globalBalance by rounding alone
+        if (std::is_same<Balance, Cents>::value && total != globalBalance)
+        {
+            balanceMismatches.fetch_add(1, std::memory_order_relaxed); // a deposit overlapped the audit
+        }
+
+        balanceRunning.fetch_sub(1, std::memory_order_release); // Decrement balanceRunning when done calculating balance
+        return total;
+    }
+
+    // Reads of a few accounts do not close the gate: the stripes exclude the deposits touching them
+    Balance get_balance(int, int account)
+    {
+        std::lock_guard<typename Locks::Mutex> lock(accountLocks.lockFor(account));
+        return bankAccounts[account];
+    }
+
+    Balance range_balance(int, int first, int last)
+    {
+        BasicStripeSetLock<BasicStripedLockTable<typename Locks::Mutex>> lock(accountLocks, first, last); // every stripe of the range, in index order
+        return sumBalances(bankAccounts, first, last);                                                    // Sum up the balances of accounts first..last
+    }
+
+    void report(EngineReport &report) const
+    {
+        int mismatches = balanceMismatches.load();
+        report.counters.emplace_back("balance_mismatches", mismatches);
+        if (mismatches != 0)
+        {
+            report.errors.push_back(std::to_string(mismatches) + " balance() calls overlapped a deposit!");
+        }
+        profileLockTable(report.locks, accountLocks);
+    }
+
+private:
+    // Wait for the transfer phase and register as a running deposit
+    void enterDepositPhase()
+    {
+        while (true)
+        {
+            while (balanceRunning.load(std::memory_order_acquire) != 0)
+            {
+                std::this_thread::yield(); // audit phase: wait for the audits to finish
+            }
+            depositsRunning.fetch_add(1, std::memory_order_seq_cst);
+            if (balanceRunning.load(std::memory_order_seq_cst) == 0)
+            {
+                return; // still in the transfer phase
+            }
+            depositsRunning.fetch_sub(1, std::memory_order_release); // an audit got in first, back off
+        }
+    }
+
+    Accounts &bankAccounts;
+    BasicStripedLockTable<typename Locks::Mutex> accountLocks; // Striped per-account locks (fine-grained)
+    const Balance globalBalance;                               // Total money in the bank (transfers never change it)
+    std::atomic<int> balanceRunning{0};                        // Tracks active (or waiting) balance computations
+    std::atomic<int> depositsRunning{0};                       // Tracks deposits inside the transfer phase
+    std::atomic<int> balanceMismatches{0};                     // Audits whose total did not match globalBalance (cents only)
+    AuditPool auditPool;                                       // helper threads for balance() (--audit-threads)
+};
+
+#endif
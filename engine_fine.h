@@ -0,0 +1,104 @@
+#ifndef ENGINE_FINE_H
+#define ENGINE_FINE_H
+
+#include <algorithm>
+#include <mutex>
+#include <shared_mutex>
+
+#include "audit_pool.h"
+#include "balance_types.h"
+#include "bank_options.h"
+#include "engine.h"
+#include "lock_profiler.h"
+#include "lock_table.h"
+
+// Per-account (striped) locks taken together with std::lock; balance() only takes a shared
+// lock that deposits never contend on
+template <typename Accounts, typename Locks = PlainLocks>
+class FineLocksEngine
+{
+public:
+    using Balance = BalanceOf<Accounts>;
+
+    FineLocksEngine(Accounts &bankAccounts, const BankOptions &options)
+        : bankAccounts(bankAccounts), accountLocks(options.lockStripes), auditPool(options.auditThreads) {}
+
+    bool deposit(int, int account1, int account2, Balance amount)
+    {
+        std::size_t stripe1 = accountLocks.stripeOf(account1);
+        std::size_t stripe2 = accountLocks.stripeOf(account2);
+
+        std::unique_lock<typename Locks::Mutex> lock1(accountLocks.stripe(std::min(stripe1, stripe2)), std::defer_lock);
+        std::unique_lock<typename Locks::Mutex> lock2;
+        if (stripe1 != stripe2)
+        {
+            lock2 = std::unique_lock<typename Locks::Mutex>(accountLocks.stripe(std::max(stripe1, stripe2)), std::defer_lock);
+            std::lock(lock1, lock2); // lock both to prevent deadlocks
+        }
+        else
+        {
+            lock1.lock(); // both accounts share a stripe, lock it once
+        }
+
+        // check balance *inside* critical section and return early if insufficient funds
+        if (bankAccounts[account1] < amount)
+        {
+            return false; // Locks will be released automatically when function exits
+        }
+
+        // dp the transfer
+        bankAccounts[account1] -= amount;
+        bankAccounts[account2] += amount;
+        return true;
+    }
+
+    // every stripe the batch touches locked once, in stripe index order, then the transfers in order
+    void deposit_batch(int, OperationBatch<Balance> transfers)
+    {
+        BasicStripeSetLock<BasicStripedLockTable<typename Locks::Mutex>> lock(accountLocks, transfers);
+        for (const auto &transfer : transfers)
+        {
+            // each transfer still checks its own funds, after the ones before it in the batch
+            if (bankAccounts[transfer.from] >= transfer.amount)
+            {
+                bankAccounts[transfer.from] -= transfer.amount;
+                bankAccounts[transfer.to] += transfer.amount;
+            }
+        }
+    }
+
+    Balance balance(int)
+    {
+        std::shared_lock<typename Locks::SharedMutex> lock(balanceMutex); // a shared lock for reading
+        Balance total = parallelSumBalances(auditPool, bankAccounts); // sum up the balances of all accounts
+        return total;
+    }
+
+    // the account's stripe is all a deposit() touching it holds too
+    Balance get_balance(int, int account)
+    {
+        std::lock_guard<typename Locks::Mutex> lock(accountLocks.lockFor(account));
+        return bankAccounts[account];
+    }
+
+    // every stripe of the range locked once, in stripe index order, so no transfer into or out of it runs meanwhile
+    Balance range_balance(int, int first, int last)
+    {
+        BasicStripeSetLock<BasicStripedLockTable<typename Locks::Mutex>> lock(accountLocks, first, last);
+        return sumBalances(bankAccounts, first, last); // sum up the balances of accounts first..last
+    }
+
+    void report(EngineReport &report) const
+    {
+        profileLock(report.locks, "balanceMutex", balanceMutex);
+        profileLockTable(report.locks, accountLocks);
+    }
+
+private:
+    Accounts &bankAccounts;
+    typename Locks::SharedMutex balanceMutex;                  // mutex to protect balance calculation (coarse-grained)
+    BasicStripedLockTable<typename Locks::Mutex> accountLocks; // striped per-account locks (fine-grained)
+    AuditPool auditPool;                                       // helper threads for balance() (--audit-threads)
+};
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef ENGINE_LOCKFREE_H
+#define ENGINE_LOCKFREE_H
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "account_store.h"
+#include "audit_pool.h"
+#include "balance_types.h"
+#include "bank_options.h"
+#include "engine.h"
+
+// Every account is a std::atomic, so deposit() needs no locks: the source is debited with a
+// CAS loop that refuses overdraft and the destination is credited with an atomic add.
+//
+// Between the debit and the credit the money is "in flight", so balance() cannot just sum
+// the accounts. Each worker thread owns an InFlightSlot whose sequence number is odd while
+// it is inside deposit(). balance() reads every slot, sums the accounts, and reads the slots
+// again: if no worker was in flight and no sequence changed, no transfer touched the accounts
+// while they were summed and the total is consistent. Otherwise it retries (never blocks).
+template <typename Accounts, typename Locks = PlainLocks>
+class LockFreeEngine
+{
+public:
+    using Balance = BalanceOf<Accounts>;
+
+    LockFreeEngine(Accounts &bankAccounts, const BankOptions &options)
+        : bankAccounts(bankAccounts), inFlightSlots(options.numThreads), auditPool(options.auditThreads) {}
+
+    bool deposit(int worker, int account1, int account2, Balance amount)
+    {
+        InFlightSlot &slot = inFlightSlots[worker];
+        std::uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+        slot.sequence.store(sequence + 1, std::memory_order_relaxed); // odd: transfer in flight
+        std::atomic_thread_fence(std::memory_order_release);           // publish the odd sequence before touching any account
+
+        // debit account1 with a CAS loop, giving up if it would overdraw
+        std::atomic<Balance> &source = bankAccounts[account1];
+        Balance funds = source.load(std::memory_order_relaxed);
+        bool debited = false;
+        while (funds >= amount)
+        {
+            if (source.compare_exchange_weak(funds, funds - amount, std::memory_order_relaxed))
+            {
+                debited = true;
+                break;
+            }
+        }
+
+        // credit account2 only if the debit went through
+        if (debited)
+        {
+            atomicAddBalance(bankAccounts[account2], amount);
+        }
+
+        slot.sequence.store(sequence + 2, std::memory_order_release); // even: transfer complete
+        return debited;
+    }
+
+    Balance balance(int worker)
+    {
+        ++inFlightSlots[worker].audits;
+        return consistent(worker, [this]
+                          { return parallelSumBalances(auditPool, bankAccounts); }); // sum up the balances of all accounts
+    }
+
+    // One account is a single atomic: its value is always one a transfer left it with, in
+    // flight or not, so no retry is needed
+    Balance get_balance(int, int account)
+    {
+        return bankAccounts[account].load(std::memory_order_acquire);
+    }
+
+    // Money in flight between two accounts of the range would be missing, so the range is
+    // summed under the same check as balance()
+    Balance range_balance(int worker, int first, int last)
+    {
+        return consistent(worker, [this, first, last]
+                          { return sumBalances(bankAccounts, first, last); });
+    }
+
+    // how often balance() and range_balance() had to retry because transfers were in flight
+    void report(EngineReport &report) const
+    {
+        std::uint64_t audits = 0;
+        std::uint64_t auditRetries = 0;
+        for (const auto &slot : inFlightSlots)
+        {
+            audits += slot.audits;
+            auditRetries += slot.auditRetries;
+        }
+        report.counters.emplace_back("balance_calls", static_cast<double>(audits));
+        report.counters.emplace_back("audit_retries", static_cast<double>(auditRetries));
+    }
+
+private:
+    struct alignas(CACHE_LINE_SIZE) InFlightSlot
+    {
+        std::atomic<std::uint64_t> sequence{0}; // odd while this worker is inside deposit()
+        std::uint64_t audits = 0;               // balance() calls made by this worker
+        std::uint64_t auditRetries = 0;         // optimistic balance() and range_balance() attempts that had to be retried
+    };
+
+    // Runs sum() until no transfer was in flight while it ran
+    template <typename Sum>
+    Balance consistent(int worker, Sum sum)
+    {
+        thread_local std::vector<std::uint64_t> sequences;
+        sequences.resize(inFlightSlots.size());
+
+        while (true)
+        {
+            // first pass over the slots: every worker must be between transfers
+            bool quiet = true;
+            for (std::size_t w = 0; w < inFlightSlots.size(); ++w)
+            {
+                sequences[w] = inFlightSlots[w].sequence.load(std::memory_order_acquire);
+                quiet = quiet && (sequences[w] % 2 == 0);
+            }
+
+            if (quiet)
+            {
+                Balance total = sum();
+                std::atomic_thread_fence(std::memory_order_acquire); // finish reading the accounts before re-reading the slots
+
+                // second pass: if no sequence moved, no transfer overlapped the sum
+                bool unchanged = true;
+                for (std::size_t w = 0; w < inFlightSlots.size() && unchanged; ++w)
+                {
+                    unchanged = inFlightSlots[w].sequence.load(std::memory_order_relaxed) == sequences[w];
+                }
+                if (unchanged)
+                {
+                    return total;
+                }
+            }
+
+            ++inFlightSlots[worker].auditRetries; // a transfer was in flight, try again
+            std::this_thread::yield();            // give an in-flight worker that got preempted a chance to finish
+        }
+    }
+
+    Accounts &bankAccounts;
+    std::vector<InFlightSlot> inFlightSlots; // one per worker thread
+    AuditPool auditPool;                     // helper threads for balance() (--audit-threads)
+};
+
+#endif
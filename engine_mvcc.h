@@ -0,0 +1,263 @@
+#ifndef ENGINE_MVCC_H
+#define ENGINE_MVCC_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "account_store.h"
+#include "balance_types.h"
+#include "bank_options.h"
+#include "engine.h"
+#include "lock_table.h"
+
+// Multi-version accounts: every transfer installs a new version of both balances, stamped
+// with one commit timestamp from a global clock, and balance() sums the versions visible at
+// a snapshot timestamp. The audit never blocks and never retries, however long the scan.
+//
+// Transfers still exclude each other per account with the striped locks of the unique
+// engine and keep bankAccounts up to date (the funds check reads it). A transfer pushes its
+// two versions with a pending stamp and only then takes its timestamp, so a snapshot that is
+// older than the stamp finds both versions already there. A reader that meets a pending
+// version does not wait: it stamps the transfer itself with a fresh, later timestamp (or
+// reads the one the writer won with), which is invisible to its snapshot.
+//
+// Reclamation uses the snapshots as epochs: a reader publishes its snapshot before reading,
+// and any version older than the newest one visible to the oldest published snapshot can
+// never be read again, so writers cut it off their chains and recycle it.
+template <typename Accounts, typename Locks = PlainLocks>
+class MvccEngine
+{
+public:
+    using Balance = BalanceOf<Accounts>;
+
+    MvccEngine(Accounts &bankAccounts, const BankOptions &options)
+        : bankAccounts(bankAccounts), accountLocks(options.lockStripes), heads(options.numAccounts + 1),
+          initialVersions(options.numAccounts + 1), workers(options.numThreads)
+    {
+        for (int account = 1; account <= options.numAccounts; ++account)
+        {
+            Version &initial = initialVersions[account];
+            initial.value = bankAccounts[account];
+            initial.stamp.store(0, std::memory_order_relaxed);
+            initial.pooled = false;
+            heads[account].store(&initial, std::memory_order_relaxed);
+        }
+    }
+
+    bool deposit(int worker, int account1, int account2, Balance amount)
+    {
+        if (account1 == account2)
+        {
+            return false; // nothing moves: two versions of one account would credit the amount without the debit
+        }
+        Worker &self = workers[worker];
+        BasicStripePairLock<BasicStripedLockTable<typename Locks::Mutex>> lock(accountLocks, account1, account2);
+
+        if (bankAccounts[account1] < amount)
+        {
+            return false; // Locks will be released automatically when function exits
+        }
+
+        // both versions go in pending, then the transfer takes its commit timestamp
+        Version *debit = allocate(self, bankAccounts[account1] - amount, nullptr);
+        Version *credit = allocate(self, bankAccounts[account2] + amount, debit);
+        install(account1, debit);
+        install(account2, credit);
+        credit->stamp.store(commitStamp(*debit), std::memory_order_release);
+
+        bankAccounts[account1] -= amount;
+        bankAccounts[account2] += amount;
+
+        if (++self.transfersSinceRefresh == SAFE_STAMP_REFRESH)
+        {
+            self.transfersSinceRefresh = 0;
+            self.safeStamp = oldestSnapshot();
+        }
+        trim(self, account1);
+        trim(self, account2);
+        return true;
+    }
+
+    Balance balance(int worker)
+    {
+        Worker &self = workers[worker];
+        ++self.audits;
+        return snapshotSum(self, 1, static_cast<int>(heads.size()) - 1);
+    }
+
+    // The same snapshot read over one account or a range: never blocks, never retries
+    Balance get_balance(int worker, int account)
+    {
+        return snapshotSum(workers[worker], account, account);
+    }
+
+    Balance range_balance(int worker, int first, int last)
+    {
+        return snapshotSum(workers[worker], first, last);
+    }
+
+    void report(EngineReport &report) const
+    {
+        std::uint64_t versions = 0, reclaimed = 0, pushed = 0, audits = 0;
+        for (const auto &worker : workers)
+        {
+            versions += worker.versions;
+            reclaimed += worker.reclaimed;
+            pushed += worker.pushedStamps;
+            audits += worker.audits;
+        }
+        report.counters.emplace_back("versions_created", static_cast<double>(versions));
+        report.counters.emplace_back("versions_reclaimed", static_cast<double>(reclaimed));
+        report.counters.emplace_back("stamps_pushed_by_readers", static_cast<double>(pushed));
+        report.counters.emplace_back("balance_calls", static_cast<double>(audits));
+        profileLockTable(report.locks, accountLocks);
+    }
+
+private:
+    static constexpr std::uint64_t PENDING = std::numeric_limits<std::uint64_t>::max(); // stamp of a transfer still committing
+    static constexpr std::uint64_t IDLE = std::numeric_limits<std::uint64_t>::max();    // published snapshot of a worker not reading
+    static constexpr int SAFE_STAMP_REFRESH = 64;                                       // transfers between two scans of the snapshots
+    static constexpr std::size_t VERSION_BLOCK = 1024;                                  // versions allocated at once
+
+    struct Version
+    {
+        Balance value = 0;
+        std::atomic<std::uint64_t> stamp{PENDING};
+        const Version *debit = nullptr;        // the credit's link to the debit version, whose stamp decides the transfer's
+        std::atomic<Version *> older{nullptr}; // the previous version of the account
+        bool pooled = true;                    // false for the initial versions, which are never recycled
+    };
+
+    struct alignas(CACHE_LINE_SIZE) Worker
+    {
+        std::atomic<std::uint64_t> snapshot{IDLE}; // read by writers computing the oldest snapshot
+        std::uint64_t safeStamp = 0;               // oldest snapshot when last computed
+        int transfersSinceRefresh = 0;
+        std::vector<Version *> freeVersions;
+        std::vector<std::unique_ptr<Version[]>> blocks;
+        std::uint64_t versions = 0;     // versions installed by this worker
+        std::uint64_t reclaimed = 0;    // versions cut off a chain by this worker
+        std::uint64_t pushedStamps = 0; // pending transfers this worker stamped while reading
+        std::uint64_t audits = 0;       // balance() calls made by this worker
+    };
+
+    Version *allocate(Worker &self, Balance value, const Version *debit)
+    {
+        if (self.freeVersions.empty())
+        {
+            self.blocks.emplace_back(new Version[VERSION_BLOCK]);
+            for (std::size_t i = 0; i < VERSION_BLOCK; ++i)
+            {
+                self.freeVersions.push_back(&self.blocks.back()[i]);
+            }
+        }
+        Version *version = self.freeVersions.back();
+        self.freeVersions.pop_back();
+        version->value = value;
+        version->stamp.store(PENDING, std::memory_order_relaxed);
+        version->debit = debit;
+        ++self.versions;
+        return version;
+    }
+
+    void install(int account, Version *version)
+    {
+        version->older.store(heads[account].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        heads[account].store(version, std::memory_order_release);
+    }
+
+    // The debit version's stamp is the transfer's: the first of the writer and any reader to
+    // set it wins, and either way both versions were installed before it was taken
+    std::uint64_t commitStamp(const Version &debit)
+    {
+        std::uint64_t stamp = debit.stamp.load(std::memory_order_acquire);
+        if (stamp != PENDING)
+        {
+            return stamp;
+        }
+        std::uint64_t fresh = clock.fetch_add(1, std::memory_order_seq_cst) + 1;
+        Version &mutableDebit = const_cast<Version &>(debit);
+        return mutableDebit.stamp.compare_exchange_strong(stamp, fresh, std::memory_order_acq_rel) ? fresh : stamp;
+    }
+
+    std::uint64_t stampOf(Worker &self, const Version &version)
+    {
+        std::uint64_t stamp = version.stamp.load(std::memory_order_acquire);
+        if (stamp != PENDING)
+        {
+            return stamp;
+        }
+        ++self.pushedStamps;
+        return commitStamp(version.debit == nullptr ? version : *version.debit);
+    }
+
+    // Sum of the accounts first..last as of a fresh snapshot
+    Balance snapshotSum(Worker &self, int first, int last)
+    {
+        // publish a lower bound before taking the snapshot, so no writer recycles what we read
+        self.snapshot.store(clock.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+        std::uint64_t snapshot = clock.load(std::memory_order_seq_cst);
+
+        Balance total = 0;
+        for (int account = first; account <= last; ++account)
+        {
+            const Version *version = heads[account].load(std::memory_order_acquire);
+            while (stampOf(self, *version) > snapshot)
+            {
+                version = version->older.load(std::memory_order_acquire); // written after our snapshot, look further back
+            }
+            total += version->value; // sum up the balances as of the snapshot
+        }
+
+        self.snapshot.store(IDLE, std::memory_order_release);
+        return total;
+    }
+
+    // Oldest snapshot any reader may still be using (a reader publishing after this scan
+    // takes its snapshot after the clock read here)
+    std::uint64_t oldestSnapshot() const
+    {
+        std::uint64_t oldest = clock.load(std::memory_order_seq_cst);
+        for (const auto &worker : workers)
+        {
+            oldest = std::min(oldest, worker.snapshot.load(std::memory_order_seq_cst));
+        }
+        return oldest;
+    }
+
+    // Cuts off the versions of account older than the newest one visible at safeStamp (called
+    // with the account locked, so no other writer changes its chain). Another worker with a
+    // newer safeStamp may already have cut the chain shorter, hence the check for its end.
+    void trim(Worker &self, int account)
+    {
+        Version *visible = heads[account].load(std::memory_order_relaxed);
+        while (visible->stamp.load(std::memory_order_acquire) > self.safeStamp && visible->older.load(std::memory_order_relaxed) != nullptr)
+        {
+            visible = visible->older.load(std::memory_order_relaxed);
+        }
+        Version *old = visible->older.exchange(nullptr, std::memory_order_relaxed);
+        while (old != nullptr)
+        {
+            Version *next = old->older.load(std::memory_order_relaxed);
+            if (old->pooled)
+            {
+                self.freeVersions.push_back(old);
+            }
+            ++self.reclaimed;
+            old = next;
+        }
+    }
+
+    Accounts &bankAccounts;
+    BasicStripedLockTable<typename Locks::Mutex> accountLocks; // striped per-account locks for the writers
+    std::vector<std::atomic<Version *>> heads;                  // newest version of every account (IDs start at 1)
+    std::vector<Version> initialVersions;                       // stamp 0, the balances before the run
+    std::vector<Worker> workers;                                // one per worker thread
+    std::atomic<std::uint64_t> clock{0};                        // last commit timestamp handed out
+};
+
+#endif
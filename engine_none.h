@@ -0,0 +1,56 @@
+#ifndef ENGINE_NONE_H
+#define ENGINE_NONE_H
+
+#include "audit_pool.h"
+#include "balance_types.h"
+#include "bank_options.h"
+#include "engine.h"
+
+// No synchronization at all: the baseline, and wrong as soon as two threads share an account
+template <typename Accounts, typename Locks = PlainLocks>
+class NoLocksEngine
+{
+public:
+    using Balance = BalanceOf<Accounts>;
+
+    NoLocksEngine(Accounts &bankAccounts, const BankOptions &options)
+        : bankAccounts(bankAccounts), auditPool(options.auditThreads) {}
+
+    bool deposit(int, int account1, int account2, Balance amount)
+    {
+        // check balance *inside* critical section and return early if insufficient funds
+        if (bankAccounts[account1] < amount)
+        {
+            return false;
+        }
+
+        // dp the transfer
+        bankAccounts[account1] -= amount;
+        bankAccounts[account2] += amount;
+        return true;
+    }
+
+    Balance balance(int)
+    {
+        Balance total = parallelSumBalances(auditPool, bankAccounts); // sum up the balances of all accounts
+        return total;
+    }
+
+    Balance get_balance(int, int account)
+    {
+        return bankAccounts[account];
+    }
+
+    Balance range_balance(int, int first, int last)
+    {
+        return sumBalances(bankAccounts, first, last); // sum up the balances of accounts first..last
+    }
+
+    void report(EngineReport &) const {}
+
+private:
+    Accounts &bankAccounts;
+    AuditPool auditPool; // helper threads for balance() (--audit-threads)
+};
+
+#endif
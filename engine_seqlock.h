@@ -0,0 +1,261 @@
+#ifndef ENGINE_SEQLOCK_H
+#define ENGINE_SEQLOCK_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "account_store.h"
+#include "audit_pool.h"
+#include "balance_types.h"
+#include "bank_options.h"
+#include "engine.h"
+#include "lock_table.h"
+
+// Every account has a sequence counter that doubles as its lock: even = unlocked, odd =
+// a deposit() holds it and is changing the balance. Transfers lock both accounts in ID
+// order (so two deposits never deadlock) and bump each sequence by 2 per transfer.
+//
+// balance() never takes a lock and never makes a deposit() wait. It reads each account's
+// sequence and balance, then re-reads all the sequences: if every sequence was even and
+// none moved, no transfer overlapped the sum and the total is consistent. Otherwise it
+// retries optimistically and counts the retry, which is the price of the audit under contention.
+template <typename Accounts, typename Locks = PlainLocks>
+class SeqlockEngine
+{
+public:
+    using Balance = BalanceOf<Accounts>;
+
+    SeqlockEngine(Accounts &bankAccounts, const BankOptions &options)
+        : bankAccounts(bankAccounts), accountSequences(options.numAccounts + 1), auditStats(options.numThreads),
+          auditPool(options.auditThreads) {}
+
+    bool deposit(int, int account1, int account2, Balance amount)
+    {
+        if (account1 == account2)
+        {
+            return false; // nothing would move, and locking the account twice would spin forever
+        }
+        int low = std::min(account1, account2);
+        int high = std::max(account1, account2);
+
+        // lock both accounts in ID order to prevent deadlocks
+        std::uint64_t lowSequence = lockAccount(low);
+        std::uint64_t highSequence = lockAccount(high);
+        std::atomic_thread_fence(std::memory_order_release); // publish the odd sequences before touching the balances
+
+        // check balance *inside* critical section and only transfer if there are enough funds
+        Balance funds = bankAccounts[account1].load(std::memory_order_relaxed);
+        bool applied = funds >= amount;
+        if (applied)
+        {
+            bankAccounts[account1].store(funds - amount, std::memory_order_relaxed);
+            bankAccounts[account2].store(bankAccounts[account2].load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+        }
+
+        unlockAccount(high, highSequence);
+        unlockAccount(low, lowSequence);
+        return applied;
+    }
+
+    // every account the batch touches locked once, in ID order (duplicates, including both sides
+    // of a transfer to the same account, removed), then the transfers in order
+    void deposit_batch(int, OperationBatch<Balance> transfers)
+    {
+        thread_local std::vector<std::size_t> accounts;         // locked accounts, ascending
+        thread_local std::vector<std::uint64_t> lockedSequences; // their sequences while locked
+        accounts.clear();
+        for (const auto &transfer : transfers)
+        {
+            accounts.push_back(transfer.from);
+            accounts.push_back(transfer.to);
+        }
+        sortUniqueIds(accounts);
+        lockedSequences.resize(accounts.size());
+        for (std::size_t i = 0; i < accounts.size(); ++i)
+        {
+            lockedSequences[i] = lockAccount(static_cast<int>(accounts[i]));
+        }
+        std::atomic_thread_fence(std::memory_order_release); // publish the odd sequences before touching the balances
+
+        for (const auto &transfer : transfers)
+        {
+            Balance funds = bankAccounts[transfer.from].load(std::memory_order_relaxed);
+            if (transfer.from != transfer.to && funds >= transfer.amount)
+            {
+                bankAccounts[transfer.from].store(funds - transfer.amount, std::memory_order_relaxed);
+                bankAccounts[transfer.to].store(bankAccounts[transfer.to].load(std::memory_order_relaxed) + transfer.amount, std::memory_order_relaxed);
+            }
+        }
+
+        for (std::size_t i = accounts.size(); i-- > 0;)
+        {
+            unlockAccount(static_cast<int>(accounts[i]), lockedSequences[i]);
+        }
+    }
+
+    Balance balance(int worker)
+    {
+        const std::size_t numAccounts = accountSequences.size() - 1;
+        const std::size_t numChunks = std::max<std::size_t>(1, (numAccounts + AUDIT_CHUNK_ACCOUNTS - 1) / AUDIT_CHUNK_ACCOUNTS);
+        thread_local std::vector<std::uint64_t> auditorSequences;
+        thread_local std::vector<BalanceSum<Balance>> auditorPartials; // running totals, rounded once at the end
+        std::vector<std::uint64_t> &sequences = auditorSequences;     // the passes may run on the helpers, which
+        std::vector<BalanceSum<Balance>> &partials = auditorPartials; // must not name the thread_locals
+        sequences.resize(accountSequences.size());
+        partials.resize(numChunks);
+        ++auditStats[worker].audits;
+
+        // both passes run chunk by chunk, on the audit helpers too (--audit-threads); the second
+        // pass only starts once every chunk of the first one is done
+        std::atomic<bool> abandoned{false};
+        auto firstPass = [&](std::size_t chunk)
+        {
+            // read each sequence before its balance, give up on any locked account
+            BalanceSum<Balance> total;
+            bool quiet = !abandoned.load(std::memory_order_relaxed) &&
+                         forEachAccount(bankAccounts, chunkFirst(chunk), chunkLast(chunk), [&](int account, const auto &balance)
+                                        {
+                                            std::uint64_t sequence = accountSequences[account].value.load(std::memory_order_acquire);
+                                            if (sequence % 2 != 0)
+                                            {
+                                                return false;
+                                            }
+                                            sequences[account] = sequence;
+                                            total.add(balance.load(std::memory_order_relaxed)); // sum up the balances of all accounts
+                                            return true; });
+            partials[chunk] = total;
+            if (!quiet)
+            {
+                abandoned.store(true, std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire); // finish reading the balances before re-reading the sequences
+        };
+        auto secondPass = [&](std::size_t chunk)
+        {
+            // if no sequence moved, every balance was read from the same instant
+            bool unchanged = !abandoned.load(std::memory_order_relaxed) &&
+                             forEachAccount(bankAccounts, chunkFirst(chunk), chunkLast(chunk), [&](int account, const auto &)
+                                            { return accountSequences[account].value.load(std::memory_order_relaxed) == sequences[account]; });
+            if (!unchanged)
+            {
+                abandoned.store(true, std::memory_order_relaxed);
+            }
+        };
+
+        while (true)
+        {
+            abandoned.store(false, std::memory_order_relaxed);
+            auditPool.run(numChunks, firstPass);
+            if (!abandoned.load(std::memory_order_relaxed))
+            {
+                auditPool.run(numChunks, secondPass);
+                if (!abandoned.load(std::memory_order_relaxed))
+                {
+                    BalanceSum<Balance> total;
+                    for (const auto &partial : partials)
+                    {
+                        total.add(partial);
+                    }
+                    return total.total();
+                }
+            }
+
+            ++auditStats[worker].auditRetries; // a transfer overlapped the sum, try again
+            std::this_thread::yield();          // don't spin on an account whose writer was descheduled
+        }
+    }
+
+    // A transfer changes each of its accounts with one store, so a single load is one of the
+    // values the account went through and needs no sequence check
+    Balance get_balance(int, int account)
+    {
+        return bankAccounts[account].load(std::memory_order_acquire);
+    }
+
+    // balance() over the accounts first..last only: sequences, balances, sequences again
+    Balance range_balance(int worker, int first, int last)
+    {
+        thread_local std::vector<std::uint64_t> sequences;
+        sequences.resize(static_cast<std::size_t>(last - first) + 1);
+        while (true)
+        {
+            BalanceSum<Balance> total;
+            bool consistent = forEachAccount(bankAccounts, first, last, [&](int account, const auto &balance)
+                                             {
+                                                 std::uint64_t sequence = accountSequences[account].value.load(std::memory_order_acquire);
+                                                 sequences[account - first] = sequence;
+                                                 total.add(balance.load(std::memory_order_relaxed));
+                                                 return sequence % 2 == 0; });
+            std::atomic_thread_fence(std::memory_order_acquire); // finish reading the balances before re-reading the sequences
+            consistent = consistent && forEachAccount(bankAccounts, first, last, [&](int account, const auto &)
+                                                      { return accountSequences[account].value.load(std::memory_order_relaxed) == sequences[account - first]; });
+            if (consistent)
+            {
+                return total.total();
+            }
+
+            ++auditStats[worker].auditRetries; // a transfer overlapped the sum, try again
+            std::this_thread::yield();
+        }
+    }
+
+    // how often balance() and range_balance() had to retry because transfers overlapped them
+    void report(EngineReport &report) const
+    {
+        std::uint64_t audits = 0;
+        std::uint64_t auditRetries = 0;
+        for (const auto &stats : auditStats)
+        {
+            audits += stats.audits;
+            auditRetries += stats.auditRetries;
+        }
+        report.counters.emplace_back("balance_calls", static_cast<double>(audits));
+        report.counters.emplace_back("audit_retries", static_cast<double>(auditRetries));
+    }
+
+private:
+    struct alignas(CACHE_LINE_SIZE) AccountSequence
+    {
+        std::atomic<std::uint64_t> value{0};
+    };
+
+    struct alignas(CACHE_LINE_SIZE) AuditStats
+    {
+        std::uint64_t audits = 0;       // balance() calls made by this worker
+        std::uint64_t auditRetries = 0; // optimistic balance() and range_balance() attempts that had to be retried
+    };
+
+    static int chunkFirst(std::size_t chunk) { return static_cast<int>(chunk * AUDIT_CHUNK_ACCOUNTS + 1); }
+    int chunkLast(std::size_t chunk) const { return static_cast<int>(std::min((chunk + 1) * AUDIT_CHUNK_ACCOUNTS, accountSequences.size() - 1)); }
+
+    // lock an account for writing: turn its even sequence odd
+    std::uint64_t lockAccount(int accountID)
+    {
+        std::atomic<std::uint64_t> &sequence = accountSequences[accountID].value;
+        while (true)
+        {
+            std::uint64_t current = sequence.load(std::memory_order_relaxed);
+            if (current % 2 == 0 && sequence.compare_exchange_weak(current, current + 1, std::memory_order_acquire))
+            {
+                return current + 1;
+            }
+            std::this_thread::yield(); // another deposit() holds this account
+        }
+    }
+
+    // unlock an account: the sequence becomes even again, 2 higher than before the transfer
+    void unlockAccount(int accountID, std::uint64_t lockedSequence)
+    {
+        accountSequences[accountID].value.store(lockedSequence + 1, std::memory_order_release);
+    }
+
+    Accounts &bankAccounts;
+    std::vector<AccountSequence> accountSequences; // indexed by account ID (IDs start at 1)
+    std::vector<AuditStats> auditStats;            // one per worker thread
+    AuditPool auditPool;                           // helper threads for balance() (--audit-threads)
+};
+
+#endif
@@ -0,0 +1,314 @@
+#ifndef ENGINE_SUBTOTAL_H
+#define ENGINE_SUBTOTAL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "account_store.h"
+#include "balance_types.h"
+#include "bank_options.h"
+#include "engine.h"
+#include "lock_profiler.h"
+#include "lock_table.h"
+
+// Subtotals kept by the transfers in a shallow aggregation tree: every leaf holds the sum of
+// LEAF_ACCOUNTS consecutive accounts and every inner node the sum of up to FANOUT nodes below
+// it, up to a top level of at most FANOUT nodes. A transfer updates the two paths from its
+// accounts' leaves up to (not including) the node where they meet, whose sum does not change,
+// so balance() adds the top level alone and range_balance() at most a few nodes per level
+// plus the accounts at its two ends. At 10M accounts that is 39 values instead of 10M.
+//
+// Transfers exclude each other per account with the striped locks of the unique engine. Each
+// worker has a sequence number that is odd while it changes accounts and subtotals, and the
+// readers accept what they summed only if no sequence was odd or moved (a consistent cut, as
+// in the escrow engine). With --verify=N every Nth balance() call of a worker also stops all
+// transfers (every stripe, in index order) and checks each subtotal against a full scan; the
+// check is exact, so bank_options.h only allows it with cents.
+template <typename Accounts, typename Locks = PlainLocks>
+class SubtotalEngine
+{
+public:
+    using Balance = BalanceOf<Accounts>;
+
+    SubtotalEngine(Accounts &bankAccounts, const BankOptions &options)
+        : bankAccounts(bankAccounts), accountLocks(options.lockStripes),
+          verifyInterval(options.verifyInterval > 0 ? options.verifyInterval : std::numeric_limits<std::uint64_t>::max()),
+          workers(options.numThreads)
+    {
+        levels.emplace_back((static_cast<std::size_t>(options.numAccounts) + LEAF_ACCOUNTS - 1) / LEAF_ACCOUNTS);
+        while (levels.back().size() > FANOUT)
+        {
+            levels.emplace_back((levels.back().size() + FANOUT - 1) / FANOUT);
+        }
+        for (const auto &account : bankAccounts)
+        {
+            addOwned(levels[0][leafOf(account.first)].sum, account.second.load(std::memory_order_relaxed));
+        }
+        for (std::size_t level = 1; level < levels.size(); ++level)
+        {
+            for (std::size_t node = 0; node < levels[level - 1].size(); ++node)
+            {
+                addOwned(levels[level][node / FANOUT].sum, levels[level - 1][node].sum.load(std::memory_order_relaxed));
+            }
+        }
+    }
+
+    bool deposit(int worker, int account1, int account2, Balance amount)
+    {
+        BasicStripePairLock<BasicStripedLockTable<typename Locks::Mutex>> lock(accountLocks, account1, account2);
+
+        Balance funds = bankAccounts[account1].load(std::memory_order_relaxed);
+        if (funds < amount)
+        {
+            return false; // Locks will be released automatically when function exits
+        }
+
+        Worker &self = workers[worker];
+        beginUpdate(self);
+        bankAccounts[account1].store(funds - amount, std::memory_order_relaxed);
+        addOwned(bankAccounts[account2], amount); // both accounts are ours while the stripes are held
+
+        std::size_t from = leafOf(account1), to = leafOf(account2);
+        for (std::size_t level = 0; level < levels.size() && from != to; ++level)
+        {
+            atomicAddBalance(levels[level][from].sum, -amount);
+            atomicAddBalance(levels[level][to].sum, amount);
+            self.subtotalUpdates += 2;
+            from /= FANOUT;
+            to /= FANOUT;
+        }
+        endUpdate(self);
+        return true;
+    }
+
+    Balance balance(int worker)
+    {
+        Worker &self = workers[worker];
+        if (++self.audits % verifyInterval == 0)
+        {
+            verify();
+        }
+        return consistent(self, [this] { return sumNodes(levels.size() - 1, 0, levels.back().size()); });
+    }
+
+    // A transfer changes each of its accounts with one store, so a single load needs no cut
+    Balance get_balance(int, int account)
+    {
+        return bankAccounts[account].load(std::memory_order_acquire);
+    }
+
+    // Sum of the accounts first..last (inclusive): the accounts of the partly covered leaves at
+    // both ends, then the fewest nodes covering the leaves in between
+    Balance range_balance(int worker, int first, int last)
+    {
+        return consistent(workers[worker], [this, first, last] {
+            std::size_t firstLeaf = leafOf(first), lastLeaf = leafOf(last);
+            if (firstLeaf == lastLeaf)
+            {
+                return sumAccounts(first, last);
+            }
+            Balance total = sumAccounts(first, static_cast<int>((firstLeaf + 1) * LEAF_ACCOUNTS));
+            total += sumNodes(0, firstLeaf + 1, lastLeaf);
+            total += sumAccounts(static_cast<int>(lastLeaf * LEAF_ACCOUNTS + 1), last);
+            return total;
+        });
+    }
+
+    void report(EngineReport &report) const
+    {
+        std::uint64_t updates = 0, audits = 0, auditRetries = 0;
+        for (const auto &worker : workers)
+        {
+            updates += worker.subtotalUpdates;
+            audits += worker.audits;
+            auditRetries += worker.auditRetries;
+        }
+        report.counters.emplace_back("tree_levels", static_cast<double>(levels.size()));
+        report.counters.emplace_back("top_level_nodes", static_cast<double>(levels.back().size()));
+        report.counters.emplace_back("subtotal_updates", static_cast<double>(updates));
+        report.counters.emplace_back("balance_calls", static_cast<double>(audits));
+        report.counters.emplace_back("audit_retries", static_cast<double>(auditRetries));
+        report.counters.emplace_back("verifications", static_cast<double>(verifications));
+        report.counters.emplace_back("verify_mismatches", static_cast<double>(mismatches));
+        report.errors.insert(report.errors.end(), verifyErrors.begin(), verifyErrors.end());
+        profileLockTable(report.locks, accountLocks);
+    }
+
+private:
+    static constexpr std::size_t LEAF_ACCOUNTS = 64; // consecutive accounts summed by one leaf
+    static constexpr std::size_t FANOUT = 64;        // nodes summed by one node of the level above
+    static constexpr std::size_t MAX_VERIFY_ERRORS = 8;
+
+    struct alignas(CACHE_LINE_SIZE) Subtotal
+    {
+        std::atomic<Balance> sum{0};
+    };
+
+    struct alignas(CACHE_LINE_SIZE) Worker
+    {
+        std::atomic<std::uint64_t> sequence{0}; // odd while this worker changes accounts and subtotals
+        std::uint64_t subtotalUpdates = 0;       // nodes changed by this worker's transfers
+        std::uint64_t audits = 0;                // balance() calls made by this worker
+        std::uint64_t auditRetries = 0;          // reads that overlapped a transfer
+    };
+
+    // Account IDs start at 1
+    static std::size_t leafOf(int account) { return static_cast<std::size_t>(account - 1) / LEAF_ACCOUNTS; }
+
+    template <typename T>
+    static void addOwned(std::atomic<T> &value, T delta)
+    {
+        value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed); // single writer, no RMW needed
+    }
+
+    void beginUpdate(Worker &self)
+    {
+        self.sequence.store(self.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); // odd: transfer running
+        std::atomic_thread_fence(std::memory_order_release);                                                 // publish it before touching any balance
+    }
+
+    void endUpdate(Worker &self)
+    {
+        self.sequence.store(self.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release); // even: subtotals match the accounts
+    }
+
+    // Runs sum() until no transfer overlapped it
+    template <typename Sum>
+    Balance consistent(Worker &self, Sum sum)
+    {
+        thread_local std::vector<std::uint64_t> sequences;
+        sequences.resize(workers.size());
+        while (true)
+        {
+            bool quiet = true;
+            for (std::size_t w = 0; w < workers.size() && quiet; ++w)
+            {
+                sequences[w] = workers[w].sequence.load(std::memory_order_acquire);
+                quiet = sequences[w] % 2 == 0;
+            }
+
+            if (quiet)
+            {
+                Balance total = sum();
+                std::atomic_thread_fence(std::memory_order_acquire); // finish reading before re-reading the sequences
+
+                bool unchanged = true;
+                for (std::size_t w = 0; w < workers.size() && unchanged; ++w)
+                {
+                    unchanged = workers[w].sequence.load(std::memory_order_relaxed) == sequences[w];
+                }
+                if (unchanged)
+                {
+                    return total;
+                }
+            }
+
+            ++self.auditRetries; // a transfer ran while we summed, try again
+            std::this_thread::yield();
+        }
+    }
+
+    // Sum of the nodes first..last-1 of a level, read from the highest levels that cover them
+    Balance sumNodes(std::size_t level, std::size_t first, std::size_t last) const
+    {
+        Balance total = 0;
+        while (first < last)
+        {
+            std::size_t up = (first + FANOUT - 1) / FANOUT, down = last / FANOUT;
+            if (level + 1 < levels.size() && up < down)
+            {
+                // the ragged ends here, the whole parents in between one level up
+                for (std::size_t node = first; node < up * FANOUT; ++node)
+                {
+                    total += levels[level][node].sum.load(std::memory_order_relaxed);
+                }
+                for (std::size_t node = down * FANOUT; node < last; ++node)
+                {
+                    total += levels[level][node].sum.load(std::memory_order_relaxed);
+                }
+                first = up;
+                last = down;
+                ++level;
+                continue;
+            }
+            for (std::size_t node = first; node < last; ++node)
+            {
+                total += levels[level][node].sum.load(std::memory_order_relaxed);
+            }
+            break;
+        }
+        return total;
+    }
+
+    Balance sumAccounts(int first, int last)
+    {
+        Balance total = 0;
+        for (int account = first; account <= last; ++account)
+        {
+            total += bankAccounts[account].load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    // Holds every stripe, so no transfer runs, and checks every node against what it sums
+    void verify()
+    {
+        std::vector<std::unique_lock<typename Locks::Mutex>> held;
+        held.reserve(accountLocks.size());
+        for (std::size_t stripe = 0; stripe < accountLocks.size(); ++stripe)
+        {
+            held.emplace_back(accountLocks.stripe(stripe)); // index order, like the transfers
+        }
+        ++verifications;
+
+        std::vector<Balance> expected(levels[0].size(), 0);
+        for (const auto &account : bankAccounts)
+        {
+            expected[leafOf(account.first)] += account.second.load(std::memory_order_relaxed); // the full scan
+        }
+        for (std::size_t level = 0; level < levels.size(); ++level)
+        {
+            std::vector<Balance> above(level + 1 < levels.size() ? levels[level + 1].size() : 0, 0);
+            for (std::size_t node = 0; node < levels[level].size(); ++node)
+            {
+                Balance sum = levels[level][node].sum.load(std::memory_order_relaxed);
+                if (sum != expected[node])
+                {
+                    mismatch("level " + std::to_string(level) + " node " + std::to_string(node) + " holds " +
+                                       std::to_string(toDollars(sum)) + ", its accounts sum to " + std::to_string(toDollars(expected[node])));
+                }
+                if (!above.empty())
+                {
+                    above[node / FANOUT] += sum; // the next level is checked against the sums it holds now
+                }
+            }
+            expected.swap(above);
+        }
+    }
+
+    // Called by verify(), with every stripe held
+    void mismatch(const std::string &what)
+    {
+        if (mismatches++ < MAX_VERIFY_ERRORS)
+        {
+            verifyErrors.push_back("subtotal mismatch: " + what);
+        }
+    }
+
+    Accounts &bankAccounts;
+    BasicStripedLockTable<typename Locks::Mutex> accountLocks; // striped per-account locks for the transfers
+    const std::uint64_t verifyInterval;                         // --verify=N (never: the largest interval)
+    std::vector<std::vector<Subtotal>> levels;                  // levels[0] the leaves, levels.back() the top level
+    std::vector<Worker> workers;                                // one per worker thread
+    std::uint64_t verifications = 0;                            // full-scan checks run (under every stripe)
+    std::uint64_t mismatches = 0;                               // nodes that disagreed with the scan (under every stripe)
+    std::vector<std::string> verifyErrors;                      // the first few mismatches (under every stripe)
+};
+
+#endif
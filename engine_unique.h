@@ -0,0 +1,88 @@
+#ifndef ENGINE_UNIQUE_H
+#define ENGINE_UNIQUE_H
+
+#include <mutex>
+#include <shared_mutex>
+
+#include "audit_pool.h"
+#include "balance_types.h"
+#include "bank_options.h"
+#include "engine.h"
+#include "lock_profiler.h"
+#include "lock_table.h"
+
+// Per-account (striped) locks held by an RAII StripePairLock in stripe index order
+template <typename Accounts, typename Locks = PlainLocks>
+class UniqueLocksEngine
+{
+public:
+    using Balance = BalanceOf<Accounts>;
+
+    UniqueLocksEngine(Accounts &bankAccounts, const BankOptions &options)
+        : bankAccounts(bankAccounts), accountLocks(options.lockStripes), auditPool(options.auditThreads) {}
+
+    bool deposit(int, int account1, int account2, Balance amount)
+    {
+        // lock both stripes in deterministic (stripe index) order
+        BasicStripePairLock<BasicStripedLockTable<typename Locks::Mutex>> lock(accountLocks, account1, account2);
+
+        if (bankAccounts[account1] < amount)
+        {
+            return false; // Locks will be released automatically when function exits
+        }
+
+        bankAccounts[account1] -= amount;
+        bankAccounts[account2] += amount;
+        return true;
+    }
+
+    // every stripe the batch touches locked once, in stripe index order, then the transfers in order
+    void deposit_batch(int, OperationBatch<Balance> transfers)
+    {
+        BasicStripeSetLock<BasicStripedLockTable<typename Locks::Mutex>> lock(accountLocks, transfers);
+        for (const auto &transfer : transfers)
+        {
+            // each transfer still checks its own funds, after the ones before it in the batch
+            if (bankAccounts[transfer.from] >= transfer.amount)
+            {
+                bankAccounts[transfer.from] -= transfer.amount;
+                bankAccounts[transfer.to] += transfer.amount;
+            }
+        }
+    }
+
+    Balance balance(int)
+    {
+        std::shared_lock<typename Locks::SharedMutex> lock(balanceMutex); // a shared lock for reading
+        Balance total = parallelSumBalances(auditPool, bankAccounts); // sum up the balances of all accounts
+        return total;
+    }
+
+    // the account's stripe is all a deposit() touching it holds too
+    Balance get_balance(int, int account)
+    {
+        std::lock_guard<typename Locks::Mutex> lock(accountLocks.lockFor(account));
+        return bankAccounts[account];
+    }
+
+    // every stripe of the range locked once, in stripe index order, so no transfer into or out of it runs meanwhile
+    Balance range_balance(int, int first, int last)
+    {
+        BasicStripeSetLock<BasicStripedLockTable<typename Locks::Mutex>> lock(accountLocks, first, last);
+        return sumBalances(bankAccounts, first, last); // sum up the balances of accounts first..last
+    }
+
+    void report(EngineReport &report) const
+    {
+        profileLock(report.locks, "balanceMutex", balanceMutex);
+        profileLockTable(report.locks, accountLocks);
+    }
+
+private:
+    Accounts &bankAccounts;
+    typename Locks::SharedMutex balanceMutex;                  // mutex to protect balance calculation (coarse-grained)
+    BasicStripedLockTable<typename Locks::Mutex> accountLocks; // striped per-account locks (fine-grained)
+    AuditPool auditPool;                                       // helper threads for balance() (--audit-threads)
+};
+
+#endif
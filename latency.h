@@ -0,0 +1,115 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "account_store.h"
+
+using LatencyClock = std::chrono::steady_clock;
+
+inline std::uint64_t nanosecondsBetween(LatencyClock::time_point start, LatencyClock::time_point end)
+{
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+}
+
+// Log-linear latency histogram (as in HdrHistogram): values below 32 ns get one bucket each,
+// every power of two above is split into 32 equal buckets, so a recorded value is off by at
+// most ~3%. record() is a few instructions and touches one counter, cheap enough to run
+// around every operation. Each worker fills its own and they are merged after the join.
+class alignas(CACHE_LINE_SIZE) LatencyHistogram
+{
+public:
+    LatencyHistogram() : buckets(NUM_BUCKETS, 0) {}
+
+    void record(std::uint64_t nanoseconds)
+    {
+        ++buckets[bucketOf(nanoseconds)];
+        ++samples;
+        largest = std::max(largest, nanoseconds);
+    }
+
+    void merge(const LatencyHistogram &other)
+    {
+        for (int i = 0; i < NUM_BUCKETS; ++i)
+        {
+            buckets[i] += other.buckets[i];
+        }
+        samples += other.samples;
+        largest = std::max(largest, other.largest);
+    }
+
+    std::uint64_t count() const { return samples; }
+    std::uint64_t max() const { return largest; }
+
+    // smallest recorded value v such that a fraction q of the samples is <= v (upper end of its bucket)
+    std::uint64_t percentile(double q) const
+    {
+        if (samples == 0)
+        {
+            return 0;
+        }
+        std::uint64_t rank = static_cast<std::uint64_t>(q * static_cast<double>(samples));
+        rank = std::max<std::uint64_t>(1, std::min(rank, samples));
+        std::uint64_t seen = 0;
+        for (int i = 0; i < NUM_BUCKETS; ++i)
+        {
+            seen += buckets[i];
+            if (seen >= rank)
+            {
+                return std::min(largest, bucketHigh(i));
+            }
+        }
+        return largest;
+    }
+
+private:
+    static constexpr int SUB_BUCKET_BITS = 5;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static constexpr int NUM_BUCKETS = SUB_BUCKETS + (64 - SUB_BUCKET_BITS) * SUB_BUCKETS;
+
+    static int bucketOf(std::uint64_t value)
+    {
+        if (value < static_cast<std::uint64_t>(SUB_BUCKETS))
+        {
+            return static_cast<int>(value);
+        }
+        int exponent = 63 - __builtin_clzll(value); // >= SUB_BUCKET_BITS
+        int shift = exponent - SUB_BUCKET_BITS;
+        return SUB_BUCKETS + shift * SUB_BUCKETS + static_cast<int>((value >> shift) - SUB_BUCKETS);
+    }
+
+    static std::uint64_t bucketHigh(int index)
+    {
+        if (index < SUB_BUCKETS)
+        {
+            return static_cast<std::uint64_t>(index);
+        }
+        int shift = (index - SUB_BUCKETS) / SUB_BUCKETS;
+        std::uint64_t mantissa = static_cast<std::uint64_t>((index - SUB_BUCKETS) % SUB_BUCKETS + SUB_BUCKETS);
+        return ((mantissa + 1) << shift) - 1;
+    }
+
+    std::vector<std::uint64_t> buckets;
+    std::uint64_t samples = 0;
+    std::uint64_t largest = 0;
+};
+
+// Cost of the two clock reads around an operation: the median of many back-to-back
+// pairs, subtracted from every recorded latency
+inline std::uint64_t measureTimerOverhead()
+{
+    constexpr int SAMPLES = 100000;
+    std::vector<std::uint64_t> pairs(SAMPLES);
+    for (auto &pair : pairs)
+    {
+        LatencyClock::time_point start = LatencyClock::now();
+        pair = nanosecondsBetween(start, LatencyClock::now());
+    }
+    std::nth_element(pairs.begin(), pairs.begin() + SAMPLES / 2, pairs.end());
+    return pairs[SAMPLES / 2];
+}
+
+#endif
@@ -0,0 +1,194 @@
+#ifndef LOCK_PROFILER_H
+#define LOCK_PROFILER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+#include "latency.h"
+#include "lock_table.h"
+
+// Opt-in lock contention profiling (--profile-locks). Engines take their lock types from a
+// policy, PlainLocks or ProfiledLocks, so an unprofiled run uses the bare std:: mutexes and
+// pays nothing for the profiler.
+
+struct LockStats
+{
+    std::uint64_t acquisitions = 0; // successful lock() / try_lock()
+    std::uint64_t contended = 0;    // lock() calls that had to wait, plus failed try_lock() calls
+    std::uint64_t waitNs = 0;       // time spent waiting in contended lock() calls
+    std::uint64_t holdNs = 0;       // time between acquisition and unlock() (exclusive holds only)
+};
+
+// std::mutex that counts its acquisitions and times waits and holds. Everything but the
+// failed try_lock() count is updated while the mutex is held, so plain fields are enough.
+class ProfiledMutex
+{
+public:
+    void lock()
+    {
+        if (mutex.try_lock())
+        {
+            holdStart = LatencyClock::now();
+        }
+        else
+        {
+            LatencyClock::time_point waitStart = LatencyClock::now();
+            mutex.lock();
+            holdStart = LatencyClock::now();
+            ++contended;
+            waitNs += nanosecondsBetween(waitStart, holdStart);
+        }
+        ++acquisitions;
+    }
+
+    bool try_lock()
+    {
+        if (!mutex.try_lock())
+        {
+            failedTryLocks.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        holdStart = LatencyClock::now();
+        ++acquisitions;
+        return true;
+    }
+
+    void unlock()
+    {
+        holdNs += nanosecondsBetween(holdStart, LatencyClock::now());
+        mutex.unlock();
+    }
+
+    // read after the workers have joined
+    LockStats stats() const
+    {
+        return {acquisitions, contended + failedTryLocks.load(std::memory_order_relaxed), waitNs, holdNs};
+    }
+
+private:
+    std::mutex mutex;
+    LatencyClock::time_point holdStart;
+    std::uint64_t acquisitions = 0;
+    std::uint64_t contended = 0;
+    std::uint64_t waitNs = 0;
+    std::uint64_t holdNs = 0;
+    std::atomic<std::uint64_t> failedTryLocks{0};
+};
+
+// std::shared_mutex with the same counters. Shared holders overlap, so their counters are
+// atomics and their hold time is not measured.
+class ProfiledSharedMutex
+{
+public:
+    void lock()
+    {
+        LatencyClock::time_point waitStart = LatencyClock::now();
+        bool waited = !mutex.try_lock();
+        if (waited)
+        {
+            mutex.lock();
+        }
+        holdStart = LatencyClock::now();
+        record(waited, waited ? nanosecondsBetween(waitStart, holdStart) : 0);
+    }
+
+    void unlock()
+    {
+        holdNs.fetch_add(nanosecondsBetween(holdStart, LatencyClock::now()), std::memory_order_relaxed);
+        mutex.unlock();
+    }
+
+    void lock_shared()
+    {
+        if (mutex.try_lock_shared())
+        {
+            record(false, 0);
+            return;
+        }
+        LatencyClock::time_point waitStart = LatencyClock::now();
+        mutex.lock_shared();
+        record(true, nanosecondsBetween(waitStart, LatencyClock::now()));
+    }
+
+    void unlock_shared() { mutex.unlock_shared(); }
+
+    LockStats stats() const
+    {
+        return {acquisitions.load(std::memory_order_relaxed), contended.load(std::memory_order_relaxed),
+                waitNs.load(std::memory_order_relaxed), holdNs.load(std::memory_order_relaxed)};
+    }
+
+private:
+    void record(bool waited, std::uint64_t waitTime)
+    {
+        acquisitions.fetch_add(1, std::memory_order_relaxed);
+        if (waited)
+        {
+            contended.fetch_add(1, std::memory_order_relaxed);
+            waitNs.fetch_add(waitTime, std::memory_order_relaxed);
+        }
+    }
+
+    std::shared_mutex mutex;
+    LatencyClock::time_point holdStart;
+    std::atomic<std::uint64_t> acquisitions{0};
+    std::atomic<std::uint64_t> contended{0};
+    std::atomic<std::uint64_t> waitNs{0};
+    std::atomic<std::uint64_t> holdNs{0};
+};
+
+// Lock types an engine is instantiated with
+struct PlainLocks
+{
+    using Mutex = std::mutex;
+    using SharedMutex = std::shared_mutex;
+};
+
+struct ProfiledLocks
+{
+    using Mutex = ProfiledMutex;
+    using SharedMutex = ProfiledSharedMutex;
+};
+
+constexpr std::size_t NOT_A_STRIPE = static_cast<std::size_t>(-1);
+
+// One profiled lock, as reported after the run
+struct LockProfile
+{
+    std::string name;
+    std::size_t stripe; // index in the account lock table, NOT_A_STRIPE for a global lock
+    LockStats stats;
+};
+
+// Called by the engines' report() for every lock they own: adds the lock's counters when it
+// is profiled and does nothing for a plain mutex
+template <typename Mutex>
+void profileLock(std::vector<LockProfile> &, const std::string &, const Mutex &) {}
+
+inline void profileLock(std::vector<LockProfile> &locks, const std::string &name, const ProfiledMutex &mutex)
+{
+    locks.push_back({name, NOT_A_STRIPE, mutex.stats()});
+}
+
+inline void profileLock(std::vector<LockProfile> &locks, const std::string &name, const ProfiledSharedMutex &mutex)
+{
+    locks.push_back({name, NOT_A_STRIPE, mutex.stats()});
+}
+
+template <typename Mutex>
+void profileLockTable(std::vector<LockProfile> &, const BasicStripedLockTable<Mutex> &) {}
+
+inline void profileLockTable(std::vector<LockProfile> &locks, const BasicStripedLockTable<ProfiledMutex> &table)
+{
+    for (std::size_t i = 0; i < table.size(); ++i)
+    {
+        locks.push_back({"stripe " + std::to_string(i), i, table.stripe(i).stats()});
+    }
+}
+
+#endif
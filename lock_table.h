@@ -0,0 +1,230 @@
+#ifndef LOCK_TABLE_H
+#define LOCK_TABLE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "account_store.h"
+
+// Upper bound for the default stripe count: 65536 padded mutexes = 4 MB, whatever the number of accounts
+constexpr std::size_t MAX_DEFAULT_LOCK_STRIPES = std::size_t(1) << 16;
+
+// Upper bound for --lock-stripes: 16M padded mutexes = 1 GB
+constexpr std::size_t MAX_LOCK_STRIPES = std::size_t(1) << 24;
+
+template <typename Mutex>
+struct alignas(CACHE_LINE_SIZE) PaddedMutex
+{
+    Mutex mutex;
+};
+
+// The smallest power of two >= n; beyond the largest power of two a size_t holds, that one
+// (doubling it would wrap to 0 and never end the loop)
+inline std::size_t roundUpToPowerOfTwo(std::size_t n)
+{
+    const std::size_t largest = ~(~std::size_t(0) >> 1);
+    std::size_t power = 1;
+    while (power < n && power < largest)
+    {
+        power <<= 1;
+    }
+    return power;
+}
+
+// Default: one stripe per account (no two accounts share a lock) until the table would
+// exceed MAX_DEFAULT_LOCK_STRIPES, then accounts start sharing stripes
+inline std::size_t defaultLockStripes(int numAccounts)
+{
+    std::size_t stripes = roundUpToPowerOfTwo(static_cast<std::size_t>(numAccounts));
+    return stripes < MAX_DEFAULT_LOCK_STRIPES ? stripes : MAX_DEFAULT_LOCK_STRIPES;
+}
+
+// Fixed-size, power-of-two table of cache-line padded mutexes. Account ID i is protected
+// by stripe (i mod size), so consecutive accounts land on different stripes and the
+// table never grows or hashes on the deposit() path.
+template <typename Mutex>
+class BasicStripedLockTable
+{
+public:
+    using mutex_type = Mutex;
+
+    explicit BasicStripedLockTable(std::size_t numStripes = 1)
+        : stripes(roundUpToPowerOfTwo(numStripes)), mask(stripes.size() - 1) {}
+
+    std::size_t stripeOf(int accountID) const { return static_cast<std::size_t>(accountID) & mask; }
+    Mutex &stripe(std::size_t index) { return stripes[index].mutex; }
+    const Mutex &stripe(std::size_t index) const { return stripes[index].mutex; }
+    Mutex &lockFor(int accountID) { return stripe(stripeOf(accountID)); }
+    std::size_t size() const { return stripes.size(); }
+
+private:
+    std::vector<PaddedMutex<Mutex>> stripes;
+    std::size_t mask;
+};
+
+using StripedLockTable = BasicStripedLockTable<std::mutex>;
+
+// Holds the stripes of two accounts for the lifetime of the object. Stripes are locked
+// in index order, so two deposits can never deadlock, and a stripe shared by both
+// accounts is locked only once.
+template <typename Table>
+class BasicStripePairLock
+{
+public:
+    BasicStripePairLock(Table &table, int account1, int account2)
+        : table(table), first(table.stripeOf(account1)), second(table.stripeOf(account2))
+    {
+        if (second < first)
+        {
+            std::swap(first, second);
+        }
+        table.stripe(first).lock();
+        if (second != first)
+        {
+            table.stripe(second).lock();
+        }
+    }
+
+    ~BasicStripePairLock()
+    {
+        if (second != first)
+        {
+            table.stripe(second).unlock();
+        }
+        table.stripe(first).unlock();
+    }
+
+    BasicStripePairLock(const BasicStripePairLock &) = delete;
+    BasicStripePairLock &operator=(const BasicStripePairLock &) = delete;
+
+private:
+    Table &table;
+    std::size_t first;
+    std::size_t second;
+};
+
+using StripePairLock = BasicStripePairLock<StripedLockTable>;
+
+// Sorts lock IDs (stripe indexes or account IDs) and drops the duplicates. Comparing random
+// IDs mispredicts most branches, so IDs within a narrow range (the few-account case, where
+// batching saves the most locks) are set in a bitmap and read back in order instead.
+inline void sortUniqueIds(std::vector<std::size_t> &ids)
+{
+    if (ids.empty())
+    {
+        return;
+    }
+    auto range = std::minmax_element(ids.begin(), ids.end());
+    std::size_t base = *range.first / 64 * 64;
+    std::size_t words = (*range.second - base) / 64 + 1;
+    if (words > 4 * ids.size())
+    {
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        return;
+    }
+    thread_local std::vector<std::uint64_t> bitmap;
+    bitmap.assign(words, 0);
+    for (std::size_t id : ids)
+    {
+        bitmap[(id - base) / 64] |= std::uint64_t{1} << ((id - base) % 64);
+    }
+    ids.clear();
+    for (std::size_t word = 0; word < words; ++word)
+    {
+        for (std::uint64_t bits = bitmap[word]; bits != 0; bits &= bits - 1)
+        {
+            ids.push_back(base + word * 64 + static_cast<std::size_t>(__builtin_ctzll(bits)));
+        }
+    }
+}
+
+// Locks the stripes of every account a batch of transfers touches (anything iterable over
+// elements with .from and .to), or of the accounts first..last: each stripe once, in stripe
+// index order like BasicStripePairLock, so batches, ranges and single transfers never deadlock
+template <typename Table>
+class BasicStripeSetLock
+{
+public:
+    template <typename Transfers>
+    BasicStripeSetLock(Table &table, const Transfers &transfers)
+        : table(table), stripes(scratch())
+    {
+        stripes.clear();
+        for (const auto &transfer : transfers)
+        {
+            stripes.push_back(table.stripeOf(transfer.from));
+            stripes.push_back(table.stripeOf(transfer.to));
+        }
+        sortUniqueIds(stripes);
+        lockAll();
+    }
+
+    // Consecutive accounts are on consecutive stripes, so a range needs no sorting: one run of
+    // stripes, two when it wraps around the end of the table, all of them when it is as long
+    // as the table
+    BasicStripeSetLock(Table &table, int first, int last)
+        : table(table), stripes(scratch())
+    {
+        stripes.clear();
+        std::size_t firstStripe = table.stripeOf(first), lastStripe = table.stripeOf(last);
+        if (static_cast<std::size_t>(last - first) + 1 >= table.size())
+        {
+            addRun(0, table.size() - 1);
+        }
+        else if (firstStripe <= lastStripe)
+        {
+            addRun(firstStripe, lastStripe);
+        }
+        else
+        {
+            addRun(0, lastStripe);
+            addRun(firstStripe, table.size() - 1);
+        }
+        lockAll();
+    }
+
+    ~BasicStripeSetLock()
+    {
+        for (auto stripe = stripes.rbegin(); stripe != stripes.rend(); ++stripe)
+        {
+            table.stripe(*stripe).unlock();
+        }
+    }
+
+    BasicStripeSetLock(const BasicStripeSetLock &) = delete;
+    BasicStripeSetLock &operator=(const BasicStripeSetLock &) = delete;
+
+private:
+    void addRun(std::size_t firstStripe, std::size_t lastStripe)
+    {
+        for (std::size_t stripe = firstStripe; stripe <= lastStripe; ++stripe)
+        {
+            stripes.push_back(stripe);
+        }
+    }
+
+    void lockAll()
+    {
+        for (std::size_t stripe : stripes)
+        {
+            table.stripe(stripe).lock();
+        }
+    }
+
+    // reused by every batch of the thread, so locking a batch does not allocate
+    static std::vector<std::size_t> &scratch()
+    {
+        thread_local std::vector<std::size_t> stripes;
+        return stripes;
+    }
+
+    Table &table;
+    std::vector<std::size_t> &stripes; // locked stripes, ascending
+};
+
+#endif
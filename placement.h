@@ -0,0 +1,394 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// Which CPU each worker thread is pinned to (--affinity)
+enum class AffinityMode
+{
+    None,    // no pinning, the scheduler may migrate the workers
+    Compact, // fill a core's hardware threads, then the next core of the same socket/node
+    Scatter, // round-robin over the sockets/nodes, one hardware thread per core first
+    List     // the CPUs given on the command line, worker t on the t-th (wrapping around)
+};
+
+struct AffinitySpec
+{
+    AffinityMode mode = AffinityMode::None;
+    std::vector<int> cpus; // for AffinityMode::List
+};
+
+// Where the memory shared by all workers (accounts, lock tables, engine state) is placed (--numa)
+enum class NumaPolicy
+{
+    None,      // first touch by the main thread, wherever it happens to run
+    Local,     // on the node running most of the workers
+    Interleave // page by page over the nodes running the workers
+};
+
+// Parses a Linux CPU list such as "0,2,4-7" (CPU ids below CPU_SETSIZE, what a cpu_set_t can hold)
+inline bool parseCpuList(const std::string &text, std::vector<int> &cpus)
+{
+    cpus.clear();
+    std::istringstream in(text);
+    std::string range;
+    while (std::getline(in, range, ','))
+    {
+        std::string::size_type dash = range.find('-');
+        try
+        {
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            if (first < 0 || last < first || last >= CPU_SETSIZE)
+            {
+                return false;
+            }
+            for (int cpu = first; cpu <= last; ++cpu)
+            {
+                cpus.push_back(cpu);
+            }
+        }
+        catch (const std::exception &)
+        {
+            return false;
+        }
+    }
+    return !cpus.empty();
+}
+
+inline std::string cpuListName(const std::vector<int> &cpus)
+{
+    std::ostringstream name;
+    for (std::size_t i = 0; i < cpus.size(); ++i)
+    {
+        name << (i == 0 ? "" : ",") << cpus[i];
+    }
+    return name.str();
+}
+
+inline bool parseAffinitySpec(const std::string &value, AffinitySpec &spec)
+{
+    spec.cpus.clear();
+    if (value == "none")
+        spec.mode = AffinityMode::None;
+    else if (value == "compact")
+        spec.mode = AffinityMode::Compact;
+    else if (value == "scatter")
+        spec.mode = AffinityMode::Scatter;
+    else if (parseCpuList(value, spec.cpus))
+        spec.mode = AffinityMode::List;
+    else
+        return false;
+    return true;
+}
+
+inline bool parseNumaPolicy(const std::string &name, NumaPolicy &policy)
+{
+    if (name == "none")
+        policy = NumaPolicy::None;
+    else if (name == "local")
+        policy = NumaPolicy::Local;
+    else if (name == "interleave")
+        policy = NumaPolicy::Interleave;
+    else
+        return false;
+    return true;
+}
+
+inline const char *numaPolicyName(NumaPolicy policy)
+{
+    switch (policy)
+    {
+    case NumaPolicy::Local:
+        return "local";
+    case NumaPolicy::Interleave:
+        return "interleave";
+    default:
+        return "none";
+    }
+}
+
+// One CPU (hardware thread) the process may run on, as described by /sys/devices/system
+struct CpuInfo
+{
+    int cpu = 0;
+    int node = 0;
+    int package = 0;
+    int core = 0;
+    int thread = 0; // index among the hardware threads of its core
+};
+
+inline int readSysfsInt(const std::string &path, int fallback)
+{
+    std::ifstream in(path);
+    int value = fallback;
+    return in >> value ? value : fallback;
+}
+
+// The CPUs in this process's affinity mask with their node, package and core (everything on
+// node 0 / package 0 when sysfs does not say otherwise)
+inline std::vector<CpuInfo> readTopology()
+{
+    std::vector<CpuInfo> cpus;
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    {
+        return cpus;
+    }
+
+    std::map<int, int> nodeOf;
+    std::ifstream onlineNodes("/sys/devices/system/node/online");
+    std::string line;
+    std::vector<int> nodes;
+    if (std::getline(onlineNodes, line) && parseCpuList(line, nodes))
+    {
+        for (int node : nodes)
+        {
+            std::ifstream cpuList("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            std::vector<int> nodeCpus;
+            if (std::getline(cpuList, line) && parseCpuList(line, nodeCpus))
+            {
+                for (int cpu : nodeCpus)
+                {
+                    nodeOf[cpu] = node;
+                }
+            }
+        }
+    }
+
+    std::map<std::pair<int, int>, int> threadsPerCore;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if (!CPU_ISSET(cpu, &allowed))
+        {
+            continue;
+        }
+        std::string topology = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+        CpuInfo info;
+        info.cpu = cpu;
+        info.node = nodeOf.count(cpu) ? nodeOf[cpu] : 0;
+        info.package = readSysfsInt(topology + "physical_package_id", 0);
+        info.core = readSysfsInt(topology + "core_id", cpu);
+        info.thread = threadsPerCore[{info.package, info.core}]++; // CPUs are visited in increasing order
+        cpus.push_back(info);
+    }
+    return cpus;
+}
+
+// Where bank_bench runs: the CPU each worker is pinned to and the NUMA policy for the memory
+// the main thread allocates before the workers start. Linux only (sched_setaffinity and the
+// set_mempolicy system call, so no libnuma is needed).
+class Placement
+{
+public:
+    // Plans the placement of numThreads workers; false (with an error) if it cannot be done
+    bool plan(const AffinitySpec &affinity, NumaPolicy numa, int numThreads)
+    {
+        affinityMode = affinity.mode;
+        numaPolicy = numa;
+        cpus = readTopology();
+        if (cpus.empty())
+        {
+            std::cerr << "Error: could not read the CPUs this process may run on" << std::endl;
+            return false;
+        }
+
+        std::vector<CpuInfo> order = cpus;
+        if (affinity.mode == AffinityMode::Compact)
+        {
+            std::sort(order.begin(), order.end(), [](const CpuInfo &a, const CpuInfo &b)
+                      { return std::tie(a.node, a.package, a.core, a.cpu) < std::tie(b.node, b.package, b.core, b.cpu); });
+        }
+        else if (affinity.mode == AffinityMode::Scatter)
+        {
+            // one queue per (node, package), first hardware threads of every core before the second ones
+            std::map<std::pair<int, int>, std::vector<CpuInfo>> domains;
+            for (const auto &cpu : cpus)
+            {
+                domains[{cpu.node, cpu.package}].push_back(cpu);
+            }
+            for (auto &domain : domains)
+            {
+                std::sort(domain.second.begin(), domain.second.end(), [](const CpuInfo &a, const CpuInfo &b)
+                          { return std::tie(a.thread, a.core, a.cpu) < std::tie(b.thread, b.core, b.cpu); });
+            }
+            order.clear();
+            for (std::size_t i = 0; order.size() < cpus.size(); ++i)
+            {
+                for (const auto &domain : domains)
+                {
+                    if (i < domain.second.size())
+                    {
+                        order.push_back(domain.second[i]);
+                    }
+                }
+            }
+        }
+        else if (affinity.mode == AffinityMode::List)
+        {
+            order.clear();
+            for (int cpu : affinity.cpus)
+            {
+                auto found = std::find_if(cpus.begin(), cpus.end(), [cpu](const CpuInfo &info)
+                                          { return info.cpu == cpu; });
+                if (found == cpus.end())
+                {
+                    std::cerr << "Error: --affinity lists cpu " << cpu << ", which this process may not run on" << std::endl;
+                    return false;
+                }
+                order.push_back(*found);
+            }
+        }
+
+        workerCpus.clear();
+        if (affinity.mode != AffinityMode::None)
+        {
+            for (int t = 0; t < numThreads; ++t)
+            {
+                workerCpus.push_back(order[t % order.size()]);
+            }
+        }
+
+        // the shared memory goes to the nodes of the workers (of every allowed CPU when unpinned)
+        std::map<int, int> workersPerNode;
+        for (const auto &cpu : workerCpus.empty() ? cpus : workerCpus)
+        {
+            ++workersPerNode[cpu.node];
+        }
+        memoryNodes.clear();
+        if (numa == NumaPolicy::Local)
+        {
+            auto busiest = std::max_element(workersPerNode.begin(), workersPerNode.end(), [](const std::pair<const int, int> &a, const std::pair<const int, int> &b)
+                                            { return a.second < b.second; });
+            memoryNodes.push_back(busiest->first);
+        }
+        else if (numa == NumaPolicy::Interleave)
+        {
+            for (const auto &node : workersPerNode)
+            {
+                memoryNodes.push_back(node.first);
+            }
+        }
+        return true;
+    }
+
+    // Makes the calling (main) thread allocate its new pages on the planned nodes; call it
+    // before the accounts and the engine are created
+    bool applyMemoryPolicy() const
+    {
+        if (numaPolicy == NumaPolicy::None)
+        {
+            return true;
+        }
+        NodeMask mask = {};
+        for (int node : memoryNodes)
+        {
+            mask[node / BITS_PER_WORD] |= 1UL << (node % BITS_PER_WORD);
+        }
+        int mode = numaPolicy == NumaPolicy::Local ? MPOL_PREFERRED : MPOL_INTERLEAVE;
+        if (setMemoryPolicy(mode, &mask) != 0)
+        {
+            std::cerr << "Error: set_mempolicy failed, cannot place memory with --numa=" << numaPolicyName(numaPolicy) << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Called by worker t itself before its timed loop: pins it to its CPU, and lets its private
+    // allocations (its operations) fall back to the local node
+    bool pinWorker(int worker) const
+    {
+        if (numaPolicy != NumaPolicy::None)
+        {
+            setMemoryPolicy(MPOL_DEFAULT, nullptr);
+        }
+        if (workerCpus.empty())
+        {
+            return true;
+        }
+        cpu_set_t cpu;
+        CPU_ZERO(&cpu);
+        CPU_SET(workerCpus[worker].cpu, &cpu);
+        return sched_setaffinity(0, sizeof(cpu), &cpu) == 0;
+    }
+
+    int workerCpu(int worker) const { return workerCpus.empty() ? -1 : workerCpus[worker].cpu; }
+
+    // e.g. "2 nodes, 2 packages, 32 cores, 64 cpus"
+    std::string topologyName() const
+    {
+        std::set<int> nodes, packages;
+        std::set<std::pair<int, int>> cores;
+        for (const auto &cpu : cpus)
+        {
+            nodes.insert(cpu.node);
+            packages.insert(cpu.package);
+            cores.insert({cpu.package, cpu.core});
+        }
+        std::ostringstream name;
+        name << nodes.size() << (nodes.size() == 1 ? " node, " : " nodes, ") << packages.size()
+             << (packages.size() == 1 ? " package, " : " packages, ") << cores.size()
+             << (cores.size() == 1 ? " core, " : " cores, ") << cpus.size() << (cpus.size() == 1 ? " cpu" : " cpus");
+        return name.str();
+    }
+
+    // e.g. "scatter (cpus 0,16,1,17)" or "none"
+    std::string affinityName() const
+    {
+        static const char *const NAMES[] = {"none", "compact", "scatter", "list"};
+        std::string name = NAMES[static_cast<int>(affinityMode)];
+        if (!workerCpus.empty())
+        {
+            std::vector<int> list;
+            for (const auto &cpu : workerCpus)
+            {
+                list.push_back(cpu.cpu);
+            }
+            name += " (cpus " + cpuListName(list) + ")";
+        }
+        return name;
+    }
+
+    // e.g. "interleave (nodes 0,1)" or "none"
+    std::string numaName() const
+    {
+        std::string name = numaPolicyName(numaPolicy);
+        if (!memoryNodes.empty())
+        {
+            name += std::string(memoryNodes.size() == 1 ? " (node " : " (nodes ") + cpuListName(memoryNodes) + ")";
+        }
+        return name;
+    }
+
+private:
+    static constexpr int MAX_NODES = 1024;
+    static constexpr int BITS_PER_WORD = 8 * sizeof(unsigned long);
+    using NodeMask = unsigned long[MAX_NODES / BITS_PER_WORD];
+
+    static long setMemoryPolicy(int mode, const NodeMask *mask)
+    {
+        return syscall(SYS_set_mempolicy, mode, mask == nullptr ? nullptr : *mask, mask == nullptr ? 0UL : MAX_NODES + 1UL);
+    }
+
+    AffinityMode affinityMode = AffinityMode::None;
+    NumaPolicy numaPolicy = NumaPolicy::None;
+    std::vector<CpuInfo> cpus;       // every CPU the process may run on
+    std::vector<CpuInfo> workerCpus; // CPU of each worker, empty without --affinity
+    std::vector<int> memoryNodes;    // nodes for --numa=local (one) or --numa=interleave
+};
+
+#endif
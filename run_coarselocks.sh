@@ -1,12 +1,13 @@
 #!/bin/bash
 
-# Set the file name and output executable
-FILE="hw1_coarse_locks.cpp"
-OUTPUT="hw1_coarse_locks"
+# Set the file name, output executable and engine (see ./bank_bench for the list)
+FILE="bank_bench.cpp"
+OUTPUT="bank_bench"
+ENGINE="coarse"
 
 # Check if the correct number of arguments is passed
 if [[ $# -lt 1 ]]; then
-  echo "Usage: $0 <num_accounts>"
+  echo "Usage: $0 <num_accounts> [options]"
   exit 1
 fi
 
@@ -39,7 +40,7 @@ if [[ $? -ne 0 ]]; then
 fi
 
 # Run the compiled program with different NUM_THREADS values
-./"$OUTPUT" "$NUM_ACCOUNTS" 2 "$NUM_ITERATIONS"
-./"$OUTPUT" "$NUM_ACCOUNTS" 4 "$NUM_ITERATIONS"
-./"$OUTPUT" "$NUM_ACCOUNTS" 8 "$NUM_ITERATIONS"
-./"$OUTPUT" "$NUM_ACCOUNTS" 16 "$NUM_ITERATIONS"
+./"$OUTPUT" "$NUM_ACCOUNTS" 2 "$NUM_ITERATIONS" --engine="$ENGINE" "${@:2}"
+./"$OUTPUT" "$NUM_ACCOUNTS" 4 "$NUM_ITERATIONS" --engine="$ENGINE" "${@:2}"
+./"$OUTPUT" "$NUM_ACCOUNTS" 8 "$NUM_ITERATIONS" --engine="$ENGINE" "${@:2}"
+./"$OUTPUT" "$NUM_ACCOUNTS" 16 "$NUM_ITERATIONS" --engine="$ENGINE" "${@:2}"
@@ -1,12 +1,13 @@
 #!/bin/bash
 
-# Set the file name and output executable
-FILE="hw1_no_locks.cpp"
-OUTPUT="hw1_no_locks"
-
-# Check if the correct number of arguments is passed (script expects 1 argument: number of accounts)
-if [ $# -ne 1 ]; then
-  echo "Usage: $0 <num_accounts>"
+# Set the file name, output executable and engine (see ./bank_bench for the list)
+FILE="bank_bench.cpp"
+OUTPUT="bank_bench"
+ENGINE="none"
+
+# Check if the correct number of arguments is passed (script expects the number of accounts, optionally followed by program options)
+if [[ $# -lt 1 ]]; then
+  echo "Usage: $0 <num_accounts> [options]"
   exit 1
 fi
 
@@ -41,7 +42,7 @@ if [[ $? -ne 0 ]]; then
 fi
 
 # Run the compiled program with different NUM_THREADS values
-./"$OUTPUT" "$NUM_ACCOUNTS" 2 "$NUM_ITERATIONS"
-./"$OUTPUT" "$NUM_ACCOUNTS" 4 "$NUM_ITERATIONS"
-./"$OUTPUT" "$NUM_ACCOUNTS" 8 "$NUM_ITERATIONS"
-./"$OUTPUT" "$NUM_ACCOUNTS" 16 "$NUM_ITERATIONS"
+./"$OUTPUT" "$NUM_ACCOUNTS" 2 "$NUM_ITERATIONS" --engine="$ENGINE" "${@:2}"
+./"$OUTPUT" "$NUM_ACCOUNTS" 4 "$NUM_ITERATIONS" --engine="$ENGINE" "${@:2}"
+./"$OUTPUT" "$NUM_ACCOUNTS" 8 "$NUM_ITERATIONS" --engine="$ENGINE" "${@:2}"
+./"$OUTPUT" "$NUM_ACCOUNTS" 16 "$NUM_ITERATIONS" --engine="$ENGINE" "${@:2}"
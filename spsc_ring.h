@@ -0,0 +1,65 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+#include "account_store.h"
+
+// Bounded lock-free single-producer single-consumer ring. One thread may push() and one
+// (other) thread may pop(); neither ever blocks, push() fails when the ring is full and pop()
+// when it is empty. The head and tail live on their own cache lines and each side keeps a
+// cached copy of the other side's index, so the shared lines are only read when the cached
+// copy says the ring looks full (producer) or empty (consumer).
+template <typename T, std::size_t Capacity>
+class SpscRing
+{
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "SpscRing capacity must be a power of two");
+
+public:
+    bool push(const T &value)
+    {
+        std::size_t tail = producer.index.load(std::memory_order_relaxed);
+        if (tail - producer.cachedOther == Capacity)
+        {
+            producer.cachedOther = consumer.index.load(std::memory_order_acquire);
+            if (tail - producer.cachedOther == Capacity)
+            {
+                return false; // full
+            }
+        }
+        slots[tail & (Capacity - 1)] = value;
+        producer.index.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &value)
+    {
+        std::size_t head = consumer.index.load(std::memory_order_relaxed);
+        if (head == consumer.cachedOther)
+        {
+            consumer.cachedOther = producer.index.load(std::memory_order_acquire);
+            if (head == consumer.cachedOther)
+            {
+                return false; // empty
+            }
+        }
+        value = slots[head & (Capacity - 1)];
+        consumer.index.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    struct alignas(CACHE_LINE_SIZE) Side
+    {
+        std::atomic<std::size_t> index{0}; // tail for the producer, head for the consumer
+        std::size_t cachedOther = 0;       // last index seen of the other side
+    };
+
+    Side producer;
+    Side consumer;
+    alignas(CACHE_LINE_SIZE) std::array<T, Capacity> slots;
+};
+
+#endif
@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+
+#include "account_store.h"
+#include "balance_generator.h"
+#include "balance_sum.h"
+#include "balance_types.h"
+
+// Measures how fast balance() scans the accounts: the original loop over std::map, the same
+// loop over a packed store, and every summation kernel of balance_sum.h this CPU supports.
+// Each path is timed over --rounds scans and reported by its best scan, in GB/s of balances
+// read and as a speedup over the map loop:
+//   sum_bench <num_accounts> [--balance=float|cents] [--rounds=N]
+
+constexpr int MAX_MAP_ACCOUNTS = 10000000; // the map loop is skipped above this (about 64 bytes per node)
+
+void printSumUsage(const char *program)
+{
+    std::cerr << "Usage: " << program << " <num_accounts> [options]\n"
+              << "  --balance=float|cents  balance representation (default: cents)\n"
+              << "  --rounds=N             scans timed per path, the best one is reported (default: 20)" << std::endl;
+}
+
+// Best time of rounds calls to scan(), in seconds; total receives what the last call returned
+template <typename Balance, typename Scan>
+double timeScan(int rounds, Balance &total, Scan scan)
+{
+    double best = 0;
+    for (int round = 0; round < rounds; ++round)
+    {
+        auto start = std::chrono::steady_clock::now();
+        total = scan();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = round == 0 ? elapsed.count() : std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+template <typename Balance>
+int runSumBench(int numAccounts, int rounds)
+{
+    const double bytes = static_cast<double>(numAccounts) * sizeof(Balance);
+    std::cout << "Summing " << numAccounts << " accounts (" << balanceTypeName(std::is_integral<Balance>::value ? BalanceType::Cents : BalanceType::Float)
+              << ", " << std::fixed << std::setprecision(1) << bytes / 1e6 << " MB of balances), best of " << rounds << " scans, "
+              << "bank_bench uses " << sumKernelName(bestSumKernel()) << std::endl;
+    std::cout << std::left << std::setw(14) << "path" << std::right << std::setw(12) << "ms/scan" << std::setw(10) << "GB/s"
+              << std::setw(10) << "speedup" << std::setw(20) << "total ($)" << std::endl;
+
+    double baseline = 0;
+    auto print = [&](const std::string &path, double seconds, Balance total)
+    {
+        if (baseline == 0)
+        {
+            baseline = seconds;
+        }
+        std::cout << std::left << std::setw(14) << path << std::right << std::fixed << std::setprecision(3) << std::setw(12) << seconds * 1e3
+                  << std::setprecision(2) << std::setw(10) << bytes / seconds / 1e9 << std::setw(9) << baseline / seconds << "x"
+                  << std::setw(20) << toDollars(total) << std::endl;
+    };
+
+    BalanceSpec spec;
+    Balance total = 0;
+    if (numAccounts <= MAX_MAP_ACCOUNTS)
+    {
+        std::map<int, Balance> mapAccounts;
+        populateAccounts(mapAccounts, spec, numAccounts);
+        double seconds = timeScan(rounds, total, [&]
+                                  {
+                                      Balance sum = 0;
+                                      for (const auto &account : mapAccounts)
+                                      {
+                                          sum += account.second; // the original balance() loop
+                                      }
+                                      return sum; });
+        print("map loop", seconds, total);
+    }
+    else
+    {
+        std::cout << "map loop      skipped above " << MAX_MAP_ACCOUNTS << " accounts" << std::endl;
+    }
+
+    PackedAccountStore<Balance> accounts(numAccounts);
+    populateAccounts(accounts, spec, numAccounts);
+    double seconds = timeScan(rounds, total, [&]
+                              {
+                                  Balance sum = 0;
+                                  for (const auto &account : accounts)
+                                  {
+                                      sum += account.second; // the same loop over the packed store
+                                  }
+                                  return sum; });
+    print("packed loop", seconds, total);
+
+    for (SumKernel kernel : {SumKernel::Scalar, SumKernel::Sse2, SumKernel::Avx2, SumKernel::Avx512})
+    {
+        if (!sumKernelSupported(kernel))
+        {
+            std::cout << std::left << std::setw(14) << sumKernelName(kernel) << "not supported by this CPU" << std::endl;
+            continue;
+        }
+        seconds = timeScan(rounds, total, [&]
+                           { return sumBalances(&accounts[1], static_cast<std::size_t>(numAccounts), kernel); });
+        print(sumKernelName(kernel), seconds, total);
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        printSumUsage(argv[0]);
+        return 1;
+    }
+    int numAccounts = std::atoi(argv[1]);
+    BalanceType balanceType = BalanceType::Cents;
+    int rounds = 20;
+    for (int i = 2; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool ok = false;
+        if (arg.rfind("--balance=", 0) == 0)
+        {
+            ok = parseBalanceType(arg.substr(10), balanceType);
+        }
+        else if (arg.rfind("--rounds=", 0) == 0)
+        {
+            rounds = std::atoi(arg.c_str() + 9);
+            ok = rounds >= 1;
+        }
+        if (!ok)
+        {
+            std::cerr << "Error: invalid option '" << arg << "'" << std::endl;
+            printSumUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (numAccounts < 1)
+    {
+        std::cerr << "Error: <num_accounts> must be at least 1" << std::endl;
+        return 1;
+    }
+
+    return withBalanceType(balanceType, [&](auto zero)
+                           { return runSumBench<decltype(zero)>(numAccounts, rounds); });
+}
@@ -0,0 +1,381 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "account_store.h"
+#include "balance_types.h"
+#include "workload.h"
+
+// Binary transaction trace: a 64-byte TraceHeader followed by numRecords TraceRecords in
+// native (little-endian) byte order. A record has exactly the layout of Operation<Cents>,
+// so with cents balances the workers replay the memory-mapped file in place.
+using TraceRecord = Operation<Cents>;
+static_assert(sizeof(TraceRecord) == 24, "the trace format expects 24-byte records");
+
+constexpr char TRACE_MAGIC[8] = {'B', 'A', 'N', 'K', 'T', 'R', 'C', '1'};
+
+struct TraceHeader
+{
+    char magic[8];
+    std::uint32_t recordSize;  // sizeof(TraceRecord)
+    std::uint32_t reserved0;
+    std::uint64_t numRecords;
+    std::uint64_t numAccounts; // highest account ID used by a deposit or a read of single accounts
+    std::uint64_t reserved[4]; // pads the header to a cache line, so the records start 64-byte aligned
+};
+static_assert(sizeof(TraceHeader) == CACHE_LINE_SIZE, "the trace header is one cache line");
+
+// How the workers share a replayed trace
+enum class TraceMode
+{
+    Partition, // worker t replays its own contiguous slice (slice t = what live stream t would have generated)
+    Shared     // every worker pulls the next batch from a shared cursor
+};
+
+// Records a shared cursor hands out at once: big enough that the cursor is not a contention point
+constexpr std::size_t TRACE_CURSOR_BATCH = 64;
+
+inline bool parseTraceMode(const std::string &name, TraceMode &mode)
+{
+    if (name == "partition")
+        mode = TraceMode::Partition;
+    else if (name == "shared")
+        mode = TraceMode::Shared;
+    else
+        return false;
+    return true;
+}
+
+inline const char *traceModeName(TraceMode mode)
+{
+    return mode == TraceMode::Partition ? "partition" : "shared";
+}
+
+// Writes a trace. The header is rewritten with the final counts by close().
+class TraceWriter
+{
+public:
+    bool open(const std::string &path)
+    {
+        out.open(path, std::ios::binary | std::ios::trunc);
+        numRecords = 0;
+        numAccounts = 0;
+        TraceHeader header = makeHeader();
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        return static_cast<bool>(out);
+    }
+
+    // accountIDs start at 1; amount in cents
+    void append(OpType type, int from, int to, Cents amount)
+    {
+        TraceRecord record;
+        std::memset(&record, 0, sizeof(record)); // no uninitialized padding in the file
+        record.type = type;
+        record.from = from;
+        record.to = to;
+        record.amount = amount;
+        out.write(reinterpret_cast<const char *>(&record), sizeof(record));
+        ++numRecords;
+        if (type != OpType::Balance)
+        {
+            numAccounts = std::max<std::uint64_t>(numAccounts, static_cast<std::uint64_t>(std::max(from, to)));
+        }
+    }
+
+    bool close()
+    {
+        TraceHeader header = makeHeader();
+        out.seekp(0);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.close();
+        return !out.fail();
+    }
+
+    std::uint64_t size() const { return numRecords; }
+
+private:
+    TraceHeader makeHeader() const
+    {
+        TraceHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+        header.recordSize = sizeof(TraceRecord);
+        header.numRecords = numRecords;
+        header.numAccounts = numAccounts;
+        return header;
+    }
+
+    std::ofstream out;
+    std::uint64_t numRecords = 0;
+    std::uint64_t numAccounts = 0;
+};
+
+// Read-only memory mapping of a trace. open() checks the header and every record once
+// (which also faults the whole file in), so replays can index accounts without checks.
+class TraceFile
+{
+public:
+    TraceFile() = default;
+    TraceFile(const TraceFile &) = delete;
+    TraceFile &operator=(const TraceFile &) = delete;
+
+    ~TraceFile()
+    {
+        if (mapping != nullptr)
+        {
+            munmap(mapping, mappingSize);
+        }
+    }
+
+    // maxAccounts = 0 skips the account range check
+    bool open(const std::string &path, int maxAccounts = 0)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            std::cerr << "Error: cannot open trace '" << path << "'" << std::endl;
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || static_cast<std::size_t>(info.st_size) < sizeof(TraceHeader))
+        {
+            std::cerr << "Error: '" << path << "' is not a trace (too short)" << std::endl;
+            ::close(fd);
+            return false;
+        }
+        int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+        flags |= MAP_POPULATE;
+#endif
+        mappingSize = static_cast<std::size_t>(info.st_size);
+        void *address = mmap(nullptr, mappingSize, PROT_READ, flags, fd, 0);
+        ::close(fd);
+        if (address == MAP_FAILED)
+        {
+            std::cerr << "Error: cannot map trace '" << path << "'" << std::endl;
+            return false;
+        }
+        mapping = address;
+        this->path = path;
+
+        const TraceHeader &header = *static_cast<const TraceHeader *>(mapping);
+        if (std::memcmp(header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0 || header.recordSize != sizeof(TraceRecord) ||
+            header.numRecords != (mappingSize - sizeof(TraceHeader)) / sizeof(TraceRecord))
+        {
+            std::cerr << "Error: '" << path << "' is not a trace or is truncated" << std::endl;
+            return false;
+        }
+        if (maxAccounts > 0 && header.numAccounts > static_cast<std::uint64_t>(maxAccounts))
+        {
+            std::cerr << "Error: trace '" << path << "' uses " << header.numAccounts << " accounts, only " << maxAccounts << " exist" << std::endl;
+            return false;
+        }
+        first = reinterpret_cast<const TraceRecord *>(static_cast<const char *>(mapping) + sizeof(TraceHeader));
+        count = static_cast<std::size_t>(header.numRecords);
+        accounts = header.numAccounts;
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const TraceRecord &record = first[i];
+            bool known = record.type == OpType::Deposit || record.type == OpType::GetBalance || record.type == OpType::RangeBalance;
+            bool valid = record.type == OpType::Balance ||
+                         (known && record.from >= 1 && record.to >= 1 &&
+                          static_cast<std::uint64_t>(record.from) <= accounts && static_cast<std::uint64_t>(record.to) <= accounts &&
+                          (record.type != OpType::Deposit || (record.from != record.to && record.amount >= 0)) &&
+                          (record.type != OpType::GetBalance || record.from == record.to) &&
+                          (record.type != OpType::RangeBalance || record.from <= record.to));
+            if (!valid)
+            {
+                std::cerr << "Error: trace '" << path << "' has an invalid record at index " << i << std::endl;
+                first = nullptr;
+                count = 0;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool isOpen() const { return first != nullptr; }
+    const TraceRecord *records() const { return first; }
+    std::size_t size() const { return count; }
+    std::uint64_t numAccounts() const { return accounts; }
+    const std::string &name() const { return path; }
+
+private:
+    void *mapping = nullptr;
+    std::size_t mappingSize = 0;
+    const TraceRecord *first = nullptr;
+    std::size_t count = 0;
+    std::uint64_t accounts = 0;
+    std::string path;
+};
+
+// A contiguous run of operations, iterable with a range-for
+template <typename Balance>
+struct OperationBatch
+{
+    const Operation<Balance> *first = nullptr;
+    const Operation<Balance> *last = nullptr;
+
+    const Operation<Balance> *begin() const { return first; }
+    const Operation<Balance> *end() const { return last; }
+};
+
+// The operations one worker runs, handed out in batches:
+//   while (operations.next(batch)) for (const auto &op : batch) { ... }
+template <typename Balance>
+class WorkerOperations
+{
+public:
+    // a fixed range (a generated stream, or a slice of a trace)
+    explicit WorkerOperations(std::vector<Operation<Balance>> owned)
+        : owned(std::move(owned)), first(this->owned.data()), count(this->owned.size()) {}
+    WorkerOperations(const Operation<Balance> *first, std::size_t count)
+        : first(first), count(count) {}
+    // the whole of [first, first + count), shared with other workers through cursor
+    WorkerOperations(const Operation<Balance> *first, std::size_t count, std::atomic<std::size_t> *cursor)
+        : first(first), count(count), cursor(cursor) {}
+
+    // Operations this worker can expect to run: its whole range, or its share of a shared one
+    std::size_t expectedCount(int numThreads) const
+    {
+        return cursor == nullptr ? count : count / static_cast<std::size_t>(numThreads);
+    }
+
+    bool next(OperationBatch<Balance> &batch)
+    {
+        std::size_t start;
+        std::size_t end;
+        if (cursor == nullptr)
+        {
+            if (done)
+                return false;
+            done = true;
+            start = 0;
+            end = count;
+        }
+        else
+        {
+            start = cursor->fetch_add(TRACE_CURSOR_BATCH, std::memory_order_relaxed);
+            if (start >= count)
+                return false;
+            end = std::min(count, start + TRACE_CURSOR_BATCH);
+        }
+        batch.first = first + start;
+        batch.last = first + end;
+        return true;
+    }
+
+private:
+    std::vector<Operation<Balance>> owned;
+    const Operation<Balance> *first;
+    std::size_t count;
+    std::atomic<std::size_t> *cursor = nullptr;
+    bool done = false;
+};
+
+// Where do_work() gets its operations: generated from a WorkloadSpec, or replayed from a
+// trace. With cents balances a trace is replayed in place (zero-copy); with float balances
+// it is converted once, before any timer starts.
+template <typename Balance>
+class OperationSource
+{
+public:
+    // trace not open: generate from spec
+    OperationSource(const WorkloadSpec &spec, int numAccounts, const TraceFile &trace, TraceMode mode)
+        : spec(spec), mode(mode), trace(trace)
+    {
+        if (!trace.isOpen())
+        {
+            workload.reset(new Workload(spec, numAccounts));
+            return;
+        }
+        if constexpr (std::is_same<Balance, Cents>::value)
+        {
+            records = trace.records();
+        }
+        else
+        {
+            converted.resize(trace.size());
+            for (std::size_t i = 0; i < trace.size(); ++i)
+            {
+                const TraceRecord &record = trace.records()[i];
+                converted[i] = {fromCents<Balance>(record.amount), record.from, record.to, record.type};
+            }
+            records = converted.data();
+        }
+    }
+
+    // Call from the worker's own thread: a generated stream is built (and first-touched) there.
+    // numIterations / numThreads operations per worker, as in the original do_work() loop;
+    // a shared cursor hands out the whole trace instead.
+    WorkerOperations<Balance> forWorker(int worker, int numThreads, int numIterations) const
+    {
+        if (workload)
+        {
+            return WorkerOperations<Balance>(generateOperations<Balance>(*workload, worker, numIterations / numThreads));
+        }
+        std::size_t total = std::min(trace.size(), static_cast<std::size_t>(numIterations));
+        if (mode == TraceMode::Shared && numThreads > 1)
+        {
+            return WorkerOperations<Balance>(records, total, &cursor.value);
+        }
+        std::size_t perWorker = total / static_cast<std::size_t>(numThreads);
+        return WorkerOperations<Balance>(records + perWorker * static_cast<std::size_t>(worker), perWorker);
+    }
+
+    std::string describe() const
+    {
+        std::ostringstream description;
+        if (workload)
+        {
+            description << "MIX = " << mixSpecName(spec);
+            if (spec.rangeWeight > 0.0)
+            {
+                description << ", RANGE = " << spec.rangeSize;
+            }
+            description << ", AMOUNT = " << amountSpecName(spec.amount)
+                        << ", SENDERS = " << skewSpecName(spec.senders)
+                        << ", RECEIVERS = " << skewSpecName(spec.receivers);
+        }
+        else
+        {
+            description << "TRACE = " << trace.name() << " (" << trace.size() << " records)"
+                        << ", MODE = " << traceModeName(mode);
+        }
+        return description.str();
+    }
+
+private:
+    struct alignas(CACHE_LINE_SIZE) PaddedCursor
+    {
+        std::atomic<std::size_t> value{0};
+    };
+
+    WorkloadSpec spec;
+    TraceMode mode;
+    const TraceFile &trace;
+    std::unique_ptr<Workload> workload;
+    std::vector<Operation<Balance>> converted;
+    const Operation<Balance> *records = nullptr;
+    mutable PaddedCursor cursor;
+};
+
+#endif
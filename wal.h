@@ -0,0 +1,452 @@
+#ifndef WAL_H
+#define WAL_H
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "account_store.h"
+#include "balance_generator.h"
+#include "balance_types.h"
+#include "workload.h"
+
+// Write-ahead log of the applied transfers (--wal=FILE): a 64-byte WalHeader, then groups of
+// WalRecords, each behind a WalGroupHeader. A group is what one flush wrote: the transfers
+// every worker committed while the previous flush ran or while the group waited to fill,
+// written with one write() and made durable with one fdatasync() (group commit). A worker's
+// deposit() returns only once its group is durable.
+//
+// Replay takes every record's amount from its source and adds it to its destination. With
+// cents the result does not depend on the order of the records, so the workers log their
+// transfers after the engine applied them, outside its locks. Float sums would round
+// differently in another order, which is why bank_options.h rejects --wal with floats. A
+// group whose checksum does not match (a crash in the middle of its write) ends the log and
+// is cut off.
+
+constexpr char WAL_MAGIC[8] = {'B', 'A', 'N', 'K', 'W', 'A', 'L', '1'};
+
+// The books a log applies to: the initial balances are generated from these, so a log is
+// never replayed over other balances
+struct WalHeader
+{
+    char magic[8];
+    std::uint32_t recordSize;   // sizeof(WalRecord<Balance>): 16 with cents, 12 with float
+    std::uint32_t distribution; // BalanceSpec (--balance-dist, --balance-shape, --total, --seed)
+    std::uint64_t numAccounts;
+    std::uint64_t seed;
+    double total;
+    double shape;
+    std::uint64_t reserved[2]; // pads the header to a cache line
+};
+static_assert(sizeof(WalHeader) == CACHE_LINE_SIZE, "the log header is one cache line");
+
+struct WalGroupHeader
+{
+    std::uint64_t firstLsn; // log sequence number of the group's first record (the first record of the log is 0)
+    std::uint64_t count;    // records in the group
+    std::uint64_t checksum; // walChecksum() of firstLsn, count and the records
+};
+
+template <typename Balance>
+struct WalRecord
+{
+    Balance amount;
+    std::int32_t from; // account debited
+    std::int32_t to;   // account credited
+};
+
+// What a flush does after its write()
+enum class WalSync
+{
+    Fdatasync, // makes the records durable, skipping metadata that does not matter for reading them back
+    Fsync,     // makes the records and all the file's metadata durable
+    None       // nothing: the records survive a crash of the process, not of the machine
+};
+
+inline bool parseWalSync(const std::string &name, WalSync &sync)
+{
+    if (name == "fdatasync")
+        sync = WalSync::Fdatasync;
+    else if (name == "fsync")
+        sync = WalSync::Fsync;
+    else if (name == "none")
+        sync = WalSync::None;
+    else
+        return false;
+    return true;
+}
+
+inline const char *walSyncName(WalSync sync)
+{
+    return sync == WalSync::Fdatasync ? "fdatasync" : (sync == WalSync::Fsync ? "fsync" : "none");
+}
+
+// FNV-1a, 64-bit
+inline std::uint64_t walChecksum(const void *data, std::size_t size, std::uint64_t hash = 14695981039346656037ull)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// The group commit log. open() replays what the file holds and starts the flusher thread;
+// commit() is called concurrently by the workers.
+template <typename Balance>
+class WriteAheadLog
+{
+public:
+    WriteAheadLog() = default;
+    WriteAheadLog(const WriteAheadLog &) = delete;
+    WriteAheadLog &operator=(const WriteAheadLog &) = delete;
+
+    ~WriteAheadLog()
+    {
+        close();
+    }
+
+    // Opens (or creates) the log at path for the books described by spec and numAccounts and
+    // applies the records from fromLsn on to bankAccounts (populated, or restored up to
+    // fromLsn). Groups are flushed once groupSize records wait or maxWait after the first of
+    // them. False, after printing why, if the file cannot be used.
+    template <typename Accounts>
+    bool open(const std::string &path, const BalanceSpec &spec, int numAccounts, Accounts &bankAccounts, std::uint64_t fromLsn,
+              int groupSize, std::chrono::microseconds maxWait, WalSync sync)
+    {
+        this->path = path;
+        this->groupSize = static_cast<std::size_t>(groupSize);
+        this->maxWait = maxWait;
+        this->sync = sync;
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) != 0)
+        {
+            std::cerr << "Error: cannot open log '" << path << "': " << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+        WalHeader expected = makeHeader(spec, numAccounts);
+        std::size_t size = static_cast<std::size_t>(info.st_size);
+        std::size_t end = sizeof(WalHeader);
+        if (size == 0)
+        {
+            if (fromLsn > 0)
+            {
+                std::cerr << "Error: log '" << path << "' is empty, it does not go on to LSN " << fromLsn << std::endl;
+                return false;
+            }
+            if (!writeAll(&expected, sizeof(expected)) || !syncFile())
+            {
+                return false;
+            }
+        }
+        else if (!replay(size, expected, bankAccounts, fromLsn, end))
+        {
+            return false;
+        }
+        if (end < size)
+        {
+            tornBytes = size - end;
+            if (ftruncate(fd, static_cast<off_t>(end)) != 0 || !syncFile())
+            {
+                std::cerr << "Error: cannot cut the torn end off log '" << path << "': " << std::strerror(errno) << std::endl;
+                return false;
+            }
+        }
+        if (lseek(fd, static_cast<off_t>(end), SEEK_SET) < 0)
+        {
+            std::cerr << "Error: cannot append to log '" << path << "': " << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+        flusher = std::thread([this] { flush(); });
+        return true;
+    }
+
+    // Logs a transfer the engine applied and returns once it is durable
+    void commit(int from, int to, Balance amount)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (filling.empty())
+        {
+            fillingSince = std::chrono::steady_clock::now();
+        }
+        filling.push_back(WalRecord<Balance>{amount, from, to});
+        std::uint64_t lsn = nextLsn++;
+        if (filling.size() == 1 || filling.size() >= groupSize)
+        {
+            flusherWake.notify_one(); // a new group to wait for, or a full one
+        }
+        durable.wait(lock, [&] { return durableLsn > lsn || failed; });
+    }
+
+    // LSN of the next record: every transfer committed so far has a lower one
+    std::uint64_t appendedLsn()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return nextLsn;
+    }
+
+    // Flushes what is left and stops the flusher (after the workers have joined)
+    void close()
+    {
+        if (flusher.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            flusherWake.notify_one();
+            flusher.join();
+        }
+        if (fd >= 0)
+        {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+
+    // What open() replayed and cut off
+    std::uint64_t replayedRecords() const { return replayed; }
+    std::uint64_t cutBytes() const { return tornBytes; }
+
+    // Read after close()
+    std::uint64_t groups() const { return flushedGroups; }
+    std::uint64_t records() const { return flushedRecords; }
+    std::uint64_t syncNanoseconds() const { return syncNs; }
+    std::uint64_t maxSyncNanoseconds() const { return maxSyncNs; }
+    const std::string &error() const { return failure; }
+
+private:
+    WalHeader makeHeader(const BalanceSpec &spec, int numAccounts) const
+    {
+        WalHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, WAL_MAGIC, sizeof(WAL_MAGIC));
+        header.recordSize = sizeof(WalRecord<Balance>);
+        header.distribution = static_cast<std::uint32_t>(spec.distribution);
+        header.numAccounts = static_cast<std::uint64_t>(numAccounts);
+        header.seed = spec.seed;
+        header.total = spec.total;
+        header.shape = spec.shape;
+        return header;
+    }
+
+    static std::uint64_t groupChecksum(const WalGroupHeader &group, const WalRecord<Balance> *records)
+    {
+        std::uint64_t hash = walChecksum(&group.firstLsn, sizeof(group.firstLsn));
+        hash = walChecksum(&group.count, sizeof(group.count), hash);
+        return walChecksum(records, group.count * sizeof(WalRecord<Balance>), hash);
+    }
+
+    // Applies the complete groups of the file; end receives the offset after the last one
+    template <typename Accounts>
+    bool replay(std::size_t size, const WalHeader &expected, Accounts &bankAccounts, std::uint64_t fromLsn, std::size_t &end)
+    {
+        void *mapping = size < sizeof(WalHeader) ? MAP_FAILED : mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED)
+        {
+            std::cerr << "Error: '" << path << "' is not a log or is truncated" << std::endl;
+            return false;
+        }
+        const char *bytes = static_cast<const char *>(mapping);
+        if (std::memcmp(bytes, &expected, sizeof(WalHeader)) != 0)
+        {
+            std::cerr << "Error: log '" << path << "' was not written for these accounts and balances (--balance, --balance-dist, "
+                      << "--balance-shape, --total, --seed)" << std::endl;
+            munmap(mapping, size);
+            return false;
+        }
+
+        const std::uint64_t numAccounts = expected.numAccounts;
+        std::uint64_t lsn = 0;
+        while (end + sizeof(WalGroupHeader) <= size)
+        {
+            WalGroupHeader group;
+            std::memcpy(&group, bytes + end, sizeof(group));
+            if (group.firstLsn != lsn || group.count == 0 || group.count > (size - end - sizeof(group)) / sizeof(WalRecord<Balance>))
+            {
+                break; // torn (or never written) group header
+            }
+            const WalRecord<Balance> *records = reinterpret_cast<const WalRecord<Balance> *>(bytes + end + sizeof(group));
+            if (groupChecksum(group, records) != group.checksum)
+            {
+                break; // torn records
+            }
+            for (std::uint64_t i = 0; i < group.count; ++i, ++lsn)
+            {
+                const WalRecord<Balance> &record = records[i];
+                if (record.from < 1 || record.to < 1 || static_cast<std::uint64_t>(record.from) > numAccounts ||
+                    static_cast<std::uint64_t>(record.to) > numAccounts)
+                {
+                    std::cerr << "Error: log '" << path << "' has an invalid record at LSN " << lsn << std::endl;
+                    munmap(mapping, size);
+                    return false;
+                }
+                if (lsn >= fromLsn)
+                {
+                    storeBalance(bankAccounts[record.from], loadBalance(bankAccounts[record.from]) - record.amount);
+                    storeBalance(bankAccounts[record.to], loadBalance(bankAccounts[record.to]) + record.amount);
+                    ++replayed;
+                }
+            }
+            end += sizeof(group) + group.count * sizeof(WalRecord<Balance>);
+        }
+        munmap(mapping, size);
+
+        if (lsn < fromLsn)
+        {
+            std::cerr << "Error: log '" << path << "' ends at LSN " << lsn << ", before LSN " << fromLsn << std::endl;
+            return false;
+        }
+        nextLsn = durableLsn = lsn;
+        return true;
+    }
+
+    // The flusher thread: takes the filling group once it is full or has waited maxWait,
+    // writes and syncs it while the next group fills, then wakes its workers
+    void flush()
+    {
+        std::vector<char> buffer;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            flusherWake.wait(lock, [this] { return stopping || !filling.empty(); });
+            if (filling.empty())
+            {
+                return; // stopping, and nothing left to write
+            }
+            flusherWake.wait_until(lock, fillingSince + maxWait, [this] { return stopping || filling.size() >= groupSize; });
+
+            writing.swap(filling);
+            filling.clear();
+            WalGroupHeader group{nextLsn - writing.size(), writing.size(), 0};
+            lock.unlock();
+
+            group.checksum = groupChecksum(group, writing.data());
+            buffer.resize(sizeof(group) + writing.size() * sizeof(WalRecord<Balance>));
+            std::memcpy(buffer.data(), &group, sizeof(group));
+            std::memcpy(buffer.data() + sizeof(group), writing.data(), writing.size() * sizeof(WalRecord<Balance>));
+            auto start = std::chrono::steady_clock::now();
+            bool written = writeAll(buffer.data(), buffer.size()) && syncFile();
+            std::uint64_t elapsed = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+            syncNs += elapsed;
+            maxSyncNs = std::max(maxSyncNs, elapsed);
+            ++flushedGroups;
+            flushedRecords += writing.size();
+
+            lock.lock();
+            if (!written)
+            {
+                failed = true; // the workers go on, run reports the error
+            }
+            durableLsn = group.firstLsn + group.count;
+            durable.notify_all();
+        }
+    }
+
+    bool writeAll(const void *data, std::size_t size)
+    {
+        const char *bytes = static_cast<const char *>(data);
+        while (size > 0)
+        {
+            ssize_t written = ::write(fd, bytes, size);
+            if (written < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (written <= 0)
+            {
+                failure = "cannot write log '" + path + "': " + std::strerror(errno);
+                return false;
+            }
+            bytes += written;
+            size -= static_cast<std::size_t>(written);
+        }
+        return true;
+    }
+
+    bool syncFile()
+    {
+        int result = sync == WalSync::Fdatasync ? fdatasync(fd) : (sync == WalSync::Fsync ? fsync(fd) : 0);
+        if (result != 0)
+        {
+            failure = "cannot sync log '" + path + "': " + std::strerror(errno);
+            return false;
+        }
+        return true;
+    }
+
+    std::string path;
+    int fd = -1;
+    std::size_t groupSize = 1;
+    std::chrono::microseconds maxWait{0};
+    WalSync sync = WalSync::Fdatasync;
+    std::thread flusher;
+
+    std::mutex mutex;                                     // guards everything up to the statistics
+    std::condition_variable flusherWake;                  // a group started filling or filled up (or stopping)
+    std::condition_variable durable;                      // durableLsn moved
+    std::vector<WalRecord<Balance>> filling;              // the next group
+    std::chrono::steady_clock::time_point fillingSince;   // when its first record arrived
+    std::uint64_t nextLsn = 0;                            // LSN of the next record committed
+    std::uint64_t durableLsn = 0;                         // every record before this one is durable
+    bool failed = false;                                  // a flush failed, commit() stops waiting
+    bool stopping = false;
+
+    std::vector<WalRecord<Balance>> writing; // the group being flushed (flusher only)
+    std::uint64_t replayed = 0;              // records applied by open()
+    std::uint64_t tornBytes = 0;             // cut off the end by open()
+    std::uint64_t flushedGroups = 0;         // flusher only, like the rest
+    std::uint64_t flushedRecords = 0;
+    std::uint64_t syncNs = 0; // write() plus sync, summed over the groups
+    std::uint64_t maxSyncNs = 0;
+    std::string failure; // the first write or sync error
+};
+
+// True if Engine::deposit() tells whether it applied the transfer, which --wal needs
+template <typename Engine, typename Balance>
+struct ReportsDeposits : std::is_same<decltype(std::declval<Engine &>().deposit(0, 0, 0, std::declval<Balance>())), bool>
+{
+};
+
+// engine.deposit(), then, with a log, makes the transfer durable before returning if the
+// engine applied it
+template <typename Engine, typename Balance>
+bool durableDeposit(Engine &engine, WriteAheadLog<Balance> *wal, int worker, const Operation<Balance> &op)
+{
+    if constexpr (ReportsDeposits<Engine, Balance>::value)
+    {
+        bool applied = engine.deposit(worker, op.from, op.to, op.amount);
+        if (applied && wal != nullptr)
+        {
+            wal->commit(op.from, op.to, op.amount);
+        }
+        return applied;
+    }
+    else
+    {
+        engine.deposit(worker, op.from, op.to, op.amount); // runBank refuses --wal for these engines
+        return true;
+    }
+}
+
+#endif
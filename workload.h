@@ -0,0 +1,426 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "balance_types.h"
+
+enum class OpType : std::uint8_t
+{
+    Deposit,     // transfer between two accounts
+    Balance,     // sum of all accounts
+    GetBalance,  // balance of one account
+    RangeBalance // sum of a contiguous range of accounts
+};
+
+constexpr int NUM_OP_TYPES = 4;
+constexpr OpType ALL_OP_TYPES[NUM_OP_TYPES] = {OpType::Deposit, OpType::Balance, OpType::GetBalance, OpType::RangeBalance};
+
+inline const char *opTypeName(OpType type)
+{
+    switch (type)
+    {
+    case OpType::Deposit:
+        return "deposit";
+    case OpType::Balance:
+        return "balance";
+    case OpType::GetBalance:
+        return "get_balance";
+    case OpType::RangeBalance:
+        return "range_balance";
+    }
+    return "unknown";
+}
+
+// How often each account is picked
+struct SkewSpec
+{
+    enum Kind
+    {
+        Uniform, // every account equally likely
+        Zipf,    // account of rank r picked with probability ~ 1 / r^theta
+        Hotspot  // a hot fraction of the accounts gets hotProbability of the picks
+    } kind = Uniform;
+    double theta = 0.99;         // Zipf exponent, in (0, 1)
+    double hotFraction = 0.01;   // Hotspot: share of accounts that are hot
+    double hotProbability = 0.9; // Hotspot: share of picks that go to a hot account
+};
+
+// How much each deposit transfers
+struct AmountSpec
+{
+    enum Kind
+    {
+        Fixed,    // always 'a' dollars
+        Uniform,  // uniform in [a, b] dollars
+        Lognormal // median 'a' dollars, sigma 'b' (heavy tail, like real payments)
+    } kind = Fixed;
+    double a = 5000.0;
+    double b = 0.0;
+};
+
+// What every worker does in do_work(): the op mix, the transfer amounts and which accounts
+// send and receive. Senders and receivers have separate popularity: sender rank r is
+// account r + 1, receiver rank r is account N - r, so the hottest senders are not also the
+// hottest receivers. The single-account and range reads pick their (first) account like
+// the senders: the customers who move money are the ones who look at it.
+struct WorkloadSpec
+{
+    double depositWeight = 95.0; // --mix=DEPOSIT/BALANCE[/GET[/RANGE]], relative weights
+    double balanceWeight = 5.0;
+    double getWeight = 0.0;
+    double rangeWeight = 0.0;
+    int rangeSize = 16; // --range-size=N: accounts read by a range_balance()
+    AmountSpec amount;
+    SkewSpec senders;
+    SkewSpec receivers;
+    std::uint64_t seed = 375;
+};
+
+// xoshiro256** (Blackman & Vigna) seeded through splitmix64: a few cycles per draw, much
+// cheaper than std::mt19937_64, and plenty random for generating workloads.
+class FastRandom
+{
+public:
+    using result_type = std::uint64_t;
+
+    explicit FastRandom(std::uint64_t seed)
+    {
+        for (auto &word : state)
+        {
+            seed += 0x9E3779B97F4A7C15ull; // splitmix64
+            std::uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            word = z ^ (z >> 31);
+        }
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return ~result_type(0); }
+
+    result_type operator()()
+    {
+        result_type result = rotl(state[1] * 5, 7) * 9;
+        result_type t = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotl(state[3], 45);
+        return result;
+    }
+
+    // uniform in [0, bound), bound > 0: Lemire's multiply-shift, no division in the common case
+    std::uint32_t below(std::uint32_t bound)
+    {
+        std::uint64_t product = static_cast<std::uint64_t>(static_cast<std::uint32_t>((*this)() >> 32)) * bound;
+        std::uint32_t low = static_cast<std::uint32_t>(product);
+        if (low < bound)
+        {
+            std::uint32_t threshold = (0u - bound) % bound;
+            while (low < threshold)
+            {
+                product = static_cast<std::uint64_t>(static_cast<std::uint32_t>((*this)() >> 32)) * bound;
+                low = static_cast<std::uint32_t>(product);
+            }
+        }
+        return static_cast<std::uint32_t>(product >> 32);
+    }
+
+    // uniform in [0, 1)
+    double unit() { return static_cast<double>((*this)() >> 11) * 0x1.0p-53; }
+
+private:
+    static result_type rotl(result_type x, int k) { return (x << k) | (x >> (64 - k)); }
+
+    result_type state[4];
+};
+
+// Picks account ranks following a SkewSpec. Zipf uses the Gray et al. generator
+// (SIGMOD '94, as in YCSB): O(N) setup once, O(1) per pick.
+class AccountPicker
+{
+public:
+    AccountPicker(const SkewSpec &spec, int numAccounts)
+        : spec(spec), numAccounts(numAccounts)
+    {
+        if (spec.kind == SkewSpec::Zipf)
+        {
+            double zetaN = 0.0;
+            for (int i = 1; i <= numAccounts; ++i)
+            {
+                zetaN += 1.0 / std::pow(static_cast<double>(i), spec.theta);
+            }
+            double zeta2 = 1.0 + 1.0 / std::pow(2.0, spec.theta);
+            zipfZetaN = zetaN;
+            zipfAlpha = 1.0 / (1.0 - spec.theta);
+            zipfEta = (1.0 - std::pow(2.0 / numAccounts, 1.0 - spec.theta)) / (1.0 - zeta2 / zetaN);
+            zipfHalfPowTheta = 1.0 + std::pow(0.5, spec.theta);
+        }
+        else if (spec.kind == SkewSpec::Hotspot)
+        {
+            hotAccounts = static_cast<int>(std::ceil(spec.hotFraction * numAccounts));
+            hotAccounts = hotAccounts < 1 ? 1 : (hotAccounts > numAccounts ? numAccounts : hotAccounts);
+        }
+    }
+
+    // rank in [0, numAccounts), 0 = most popular
+    int pick(FastRandom &gen) const
+    {
+        switch (spec.kind)
+        {
+        case SkewSpec::Uniform:
+            return static_cast<int>(gen.below(numAccounts));
+        case SkewSpec::Zipf:
+        {
+            double u = gen.unit();
+            double uz = u * zipfZetaN;
+            if (uz < 1.0)
+                return 0;
+            if (uz < zipfHalfPowTheta)
+                return 1;
+            int rank = static_cast<int>(numAccounts * std::pow(zipfEta * u - zipfEta + 1.0, zipfAlpha));
+            return rank < numAccounts ? rank : numAccounts - 1;
+        }
+        case SkewSpec::Hotspot:
+            if (hotAccounts == numAccounts || gen.unit() < spec.hotProbability)
+                return static_cast<int>(gen.below(hotAccounts));
+            return hotAccounts + static_cast<int>(gen.below(numAccounts - hotAccounts));
+        }
+        return 0;
+    }
+
+private:
+    SkewSpec spec;
+    int numAccounts;
+    double zipfZetaN = 0.0;
+    double zipfAlpha = 0.0;
+    double zipfEta = 0.0;
+    double zipfHalfPowTheta = 0.0;
+    int hotAccounts = 0;
+};
+
+// One pre-generated operation: 16 bytes with float balances, 24 with cents
+template <typename Balance>
+struct Operation
+{
+    Balance amount;    // deposit only
+    std::int32_t from; // deposit: account debited; get_balance: the account; range_balance: first account
+    std::int32_t to;   // deposit: account credited; get_balance: the account; range_balance: last account
+    OpType type;
+};
+
+// Shared, read-only part of a workload (built once: the Zipf setup is O(N))
+struct Workload
+{
+    Workload(const WorkloadSpec &spec, int numAccounts)
+        : spec(spec), numAccounts(numAccounts), senders(spec.senders, numAccounts), receivers(spec.receivers, numAccounts) {}
+
+    WorkloadSpec spec;
+    int numAccounts;
+    AccountPicker senders;
+    AccountPicker receivers;
+};
+
+// Per-thread stream of operations. Each stream is seeded from the workload seed and the
+// stream number, so a run is reproducible for a given --seed and thread count.
+template <typename Balance>
+class OperationGenerator
+{
+public:
+    OperationGenerator(const Workload &workload, int stream)
+        : workload(workload), gen(workload.spec.seed * 0x9E3779B97F4A7C15ull + 0x632BE59BD9B4E019ull * (stream + 1)),
+          depositProbability(workload.spec.depositWeight / totalWeight(workload.spec)),
+          balanceProbability((workload.spec.depositWeight + workload.spec.balanceWeight) / totalWeight(workload.spec)),
+          getProbability((workload.spec.depositWeight + workload.spec.balanceWeight + workload.spec.getWeight) / totalWeight(workload.spec)) {}
+
+    Operation<Balance> next()
+    {
+        Operation<Balance> op{0, 0, 0, OpType::Balance};
+        double draw = gen.unit(); // one draw per operation, so --mix=D/B streams stay what they were
+        if (draw >= balanceProbability)
+        {
+            op.type = draw < getProbability ? OpType::GetBalance : OpType::RangeBalance;
+            op.from = workload.senders.pick(gen) + 1;
+            op.to = op.type == OpType::GetBalance ? op.from : std::min(op.from + workload.spec.rangeSize - 1, workload.numAccounts);
+            return op;
+        }
+        if (draw >= depositProbability)
+        {
+            return op;
+        }
+
+        op.type = OpType::Deposit;
+        op.from = workload.senders.pick(gen) + 1;
+        op.to = workload.numAccounts - workload.receivers.pick(gen);
+        while (op.to == op.from)
+        {
+            op.to = workload.numAccounts - workload.receivers.pick(gen);
+        }
+        op.amount = nextAmount();
+        return op;
+    }
+
+private:
+    static double totalWeight(const WorkloadSpec &spec)
+    {
+        return spec.depositWeight + spec.balanceWeight + spec.getWeight + spec.rangeWeight;
+    }
+
+    Balance nextAmount()
+    {
+        const AmountSpec &amount = workload.spec.amount;
+        switch (amount.kind)
+        {
+        case AmountSpec::Fixed:
+            return toBalance<Balance>(amount.a);
+        case AmountSpec::Uniform:
+            return toBalance<Balance>(amount.a + (amount.b - amount.a) * gen.unit());
+        case AmountSpec::Lognormal:
+            return toBalance<Balance>(std::lognormal_distribution<double>(std::log(amount.a), amount.b)(gen));
+        }
+        return 0;
+    }
+
+    const Workload &workload;
+    FastRandom gen;
+    double depositProbability; // the op types' cumulative shares of the mix
+    double balanceProbability;
+    double getProbability;
+};
+
+// Generates a worker's whole stream into one contiguous buffer before its timed loop starts,
+// so the loop only measures synchronization and account access (no RNG, no re-rolls)
+template <typename Balance>
+std::vector<Operation<Balance>> generateOperations(const Workload &workload, int stream, int count)
+{
+    OperationGenerator<Balance> generator(workload, stream);
+    std::vector<Operation<Balance>> operations(count);
+    for (auto &op : operations)
+    {
+        op = generator.next();
+    }
+    return operations;
+}
+
+// Splits "a:b:c" into its fields
+inline std::vector<std::string> splitWorkloadArg(const std::string &value, char separator)
+{
+    std::vector<std::string> fields;
+    std::stringstream stream(value);
+    std::string field;
+    while (std::getline(stream, field, separator))
+    {
+        fields.push_back(field);
+    }
+    return fields;
+}
+
+// uniform | zipf[:THETA] | hotspot[:FRACTION[:PROBABILITY]]
+inline bool parseSkewSpec(const std::string &value, SkewSpec &spec)
+{
+    std::vector<std::string> fields = splitWorkloadArg(value, ':');
+    if (fields.empty())
+        return false;
+    if (fields[0] == "uniform" && fields.size() == 1)
+    {
+        spec.kind = SkewSpec::Uniform;
+        return true;
+    }
+    if (fields[0] == "zipf" && fields.size() <= 2)
+    {
+        spec.kind = SkewSpec::Zipf;
+        if (fields.size() == 2)
+            spec.theta = std::stod(fields[1]);
+        return spec.theta > 0.0 && spec.theta < 1.0;
+    }
+    if (fields[0] == "hotspot" && fields.size() <= 3)
+    {
+        spec.kind = SkewSpec::Hotspot;
+        if (fields.size() >= 2)
+            spec.hotFraction = std::stod(fields[1]);
+        if (fields.size() == 3)
+            spec.hotProbability = std::stod(fields[2]);
+        return spec.hotFraction > 0.0 && spec.hotFraction <= 1.0 && spec.hotProbability >= 0.0 && spec.hotProbability <= 1.0;
+    }
+    return false;
+}
+
+// fixed:DOLLARS | uniform:MIN:MAX | lognormal:MEDIAN:SIGMA
+inline bool parseAmountSpec(const std::string &value, AmountSpec &spec)
+{
+    std::vector<std::string> fields = splitWorkloadArg(value, ':');
+    if (fields.size() == 2 && fields[0] == "fixed")
+    {
+        spec = {AmountSpec::Fixed, std::stod(fields[1]), 0.0};
+        return spec.a >= 0.0;
+    }
+    if (fields.size() == 3 && fields[0] == "uniform")
+    {
+        spec = {AmountSpec::Uniform, std::stod(fields[1]), std::stod(fields[2])};
+        return spec.a >= 0.0 && spec.a <= spec.b;
+    }
+    if (fields.size() == 3 && fields[0] == "lognormal")
+    {
+        spec = {AmountSpec::Lognormal, std::stod(fields[1]), std::stod(fields[2])};
+        return spec.a > 0.0 && spec.b >= 0.0;
+    }
+    return false;
+}
+
+// DEPOSIT/BALANCE[/GET[/RANGE]] relative weights, e.g. 95/5 or 20/1/60/19
+inline bool parseMixSpec(const std::string &value, WorkloadSpec &spec)
+{
+    std::vector<std::string> fields = splitWorkloadArg(value, '/');
+    if (fields.size() < 2 || fields.size() > 4)
+        return false;
+    spec.depositWeight = std::stod(fields[0]);
+    spec.balanceWeight = std::stod(fields[1]);
+    spec.getWeight = fields.size() >= 3 ? std::stod(fields[2]) : 0.0;
+    spec.rangeWeight = fields.size() == 4 ? std::stod(fields[3]) : 0.0;
+    return spec.depositWeight >= 0.0 && spec.balanceWeight >= 0.0 && spec.getWeight >= 0.0 && spec.rangeWeight >= 0.0 &&
+           spec.depositWeight + spec.balanceWeight + spec.getWeight + spec.rangeWeight > 0.0;
+}
+
+inline std::string mixSpecName(const WorkloadSpec &spec)
+{
+    std::ostringstream name;
+    name << spec.depositWeight << "/" << spec.balanceWeight;
+    if (spec.getWeight > 0.0 || spec.rangeWeight > 0.0)
+        name << "/" << spec.getWeight << "/" << spec.rangeWeight;
+    return name.str();
+}
+
+inline std::string skewSpecName(const SkewSpec &spec)
+{
+    std::ostringstream name;
+    if (spec.kind == SkewSpec::Zipf)
+        name << "zipf:" << spec.theta;
+    else if (spec.kind == SkewSpec::Hotspot)
+        name << "hotspot:" << spec.hotFraction << ":" << spec.hotProbability;
+    else
+        name << "uniform";
+    return name.str();
+}
+
+inline std::string amountSpecName(const AmountSpec &spec)
+{
+    std::ostringstream name;
+    if (spec.kind == AmountSpec::Uniform)
+        name << "uniform:" << spec.a << ":" << spec.b;
+    else if (spec.kind == AmountSpec::Lognormal)
+        name << "lognormal:" << spec.a << ":" << spec.b;
+    else
+        name << "fixed:" << spec.a;
+    return name.str();
+}
+
+#endif